@@ -0,0 +1,121 @@
+/*
+Google Benchmark target for the block coder.
+
+Every member of the generated corpus (bench_corpus() in bench.cpp) is
+compressed and decompressed in each mode, one thread, as the CLI codes it:
+in chunks of the default block size cut into blocks by encode_chunk, with
+one encoder and one decoder kept across runs.  Each benchmark reports
+throughput over the raw size (bytes_per_second) and the compression ratio
+(compressed / raw) as a counter.  The corpus is
+deterministic, so results from different commits can be compared directly:
+
+    huffzip_benchmark --benchmark_out=new.json --benchmark_out_format=json
+    compare.py benchmarks old.json new.json      (from Google Benchmark's tools)
+*/
+
+#include <bits/stdc++.h>
+#include <benchmark/benchmark.h>
+#include "bench.h"
+
+using namespace std;
+
+struct BenchMode {
+    const char* name;
+    bool huffman_only;
+    int level;
+};
+
+static const BenchMode BENCH_MODES[] = {
+    { "huffman", true, 6 },
+    { "lz1", false, 1 },
+    { "lz6", false, 6 },
+    { "lz9", false, 9 },
+};
+
+// A corpus member coded as the CLI codes it: cut into chunks of
+// DEFAULT_BLOCK_SIZE, each cut into blocks by encode_chunk.
+struct Packed {
+    vector<vector<uint8_t>> payloads;
+    vector<size_t> sizes;         // raw size of each block
+    vector<size_t> chunk_sizes;   // encode_chunk's block sizes of one chunk
+};
+
+// Code `data` into `packed` with `encoder`.  The payloads are swapped out of
+// the encoder, so their buffers go back to it on the next run.
+static void compress_all(BlockEncoder& encoder, const vector<uint8_t>& data, const BenchMode& mode,
+    Packed& packed) {
+    size_t count = 0;
+    packed.sizes.clear();
+    for (size_t off = 0; off < data.size(); off += DEFAULT_BLOCK_SIZE) {
+        size_t n = min(DEFAULT_BLOCK_SIZE, data.size() - off);
+        vector<vector<uint8_t>>& coded = encoder.encode_chunk(data.data() + off, n, packed.chunk_sizes,
+            mode.huffman_only, mode.level);
+        for (size_t i = 0; i < packed.chunk_sizes.size(); i++) {
+            if (count == packed.payloads.size()) packed.payloads.emplace_back();
+            swap(packed.payloads[count++], coded[i]);
+            packed.sizes.push_back(packed.chunk_sizes[i]);
+        }
+    }
+    packed.payloads.resize(count);
+}
+
+static double packed_ratio(const vector<uint8_t>& data, const Packed& packed) {
+    size_t size = 0;
+    for (auto& p : packed.payloads) size += BLOCK_HEADER_SIZE + p.size();
+    return data.empty() ? 0.0 : (double)size / data.size();
+}
+
+static void bm_compress(benchmark::State& state, const vector<uint8_t>* data, BenchMode mode) {
+    BlockEncoder encoder;
+    Packed packed;
+    for (auto _ : state) {
+        compress_all(encoder, *data, mode, packed);
+        benchmark::DoNotOptimize(packed.payloads.data());
+    }
+    state.SetBytesProcessed((int64_t)state.iterations() * data->size());
+    state.counters["ratio"] = packed_ratio(*data, packed);
+}
+
+static void bm_decompress(benchmark::State& state, const vector<uint8_t>* data, BenchMode mode) {
+    BlockEncoder encoder;
+    BlockDecoder decoder;
+    Packed packed;
+    compress_all(encoder, *data, mode, packed);
+    vector<uint8_t> out(data->size());
+    for (auto _ : state) {
+        size_t off = 0;
+        for (size_t b = 0; b < packed.payloads.size(); b++) {
+            const vector<uint8_t>& p = packed.payloads[b];
+            if (!decoder.decode(p.data(), p.size(), packed.sizes[b], out.data() + off)) {
+                state.SkipWithError("corrupt payload");
+                return;
+            }
+            off += packed.sizes[b];
+        }
+        benchmark::DoNotOptimize(out.data());
+    }
+    if (out != *data) {
+        state.SkipWithError("round trip failed");
+        return;
+    }
+    state.SetBytesProcessed((int64_t)state.iterations() * data->size());
+    state.counters["ratio"] = packed_ratio(*data, packed);
+}
+
+int main(int argc, char** argv) {
+    static const vector<BenchInput> corpus = bench_corpus();
+    for (const BenchInput& input : corpus) {
+        for (const BenchMode& mode : BENCH_MODES) {
+            string suffix = string(mode.name) + "/" + input.name;
+            benchmark::RegisterBenchmark(("compress/" + suffix).c_str(), bm_compress, &input.data, mode)
+                ->Unit(benchmark::kMillisecond);
+            benchmark::RegisterBenchmark(("decompress/" + suffix).c_str(), bm_decompress, &input.data, mode)
+                ->Unit(benchmark::kMillisecond);
+        }
+    }
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,361 @@
+/*
+The library API (huffzip.h) over the container code.
+
+The compressor buffers input up to one block size and codes each full chunk,
+cut into blocks by BlockEncoder::encode_chunk; input that arrives in
+block-sized pieces is coded in place.
+The decompressor parses the container incrementally: it works directly on
+the caller's data when a whole header, block or trailer is there, and
+otherwise collects the piece in a buffer until it is complete.  Blocks are
+decoded straight into the output vector.
+
+Built on its own as the huffzip static library.
+*/
+
+#include <bits/stdc++.h>
+#include "huffzip.h"
+#include "container.h"
+#include "crc32.h"
+
+using namespace std;
+
+// Appends to a vector; the sink for the container writers.
+struct _VectorSink {
+    vector<uint8_t>& v;
+    void write(const void* p, size_t n) {
+        const uint8_t* b = (const uint8_t*)p;
+        v.insert(v.end(), b, b + n);
+    }
+};
+
+struct HuffzipDictionary::Impl {
+    Dictionary dict;
+};
+
+HuffzipDictionary::HuffzipDictionary() : impl(new Impl) {}
+HuffzipDictionary::~HuffzipDictionary() = default;
+HuffzipDictionary::HuffzipDictionary(HuffzipDictionary&&) noexcept = default;
+HuffzipDictionary& HuffzipDictionary::operator=(HuffzipDictionary&&) noexcept = default;
+
+bool HuffzipDictionary::load(const void* data, size_t size) {
+    Dictionary d;
+    if (!d.parse((const uint8_t*)data, size)) return false;
+    impl->dict = move(d);
+    return true;
+}
+
+bool HuffzipDictionary::train(const vector<vector<uint8_t>>& samples, size_t size, int level, uint32_t id) {
+    if (samples.empty()) return false;
+    impl->dict = train_dictionary(samples, size, level, id);
+    return true;
+}
+
+vector<uint8_t> HuffzipDictionary::save() const { return impl->dict.serialize(); }
+
+uint32_t HuffzipDictionary::id() const { return impl->dict.id; }
+
+struct HuffzipCompressor::Impl {
+    HuffzipOptions opt;
+    const Dictionary* dict = nullptr;
+    BlockEncoder encoder;
+    vector<uint8_t> pending;      // partial chunk
+    vector<size_t> sizes;         // blocks of the chunk being coded
+    vector<IndexEntry> index;
+    uint64_t offset = 0;          // bytes written so far, 0 before the header
+    uint64_t total = 0;
+    uint32_t crc = 0;
+    const char* error = nullptr;
+
+    void clear() {
+        pending.clear();
+        index.clear();
+        offset = total = 0;
+        crc = 0;
+        error = nullptr;
+    }
+
+    void start(vector<uint8_t>& out) {
+        if (offset) return;
+        _VectorSink sink{ out };
+        offset = put_header(sink, opt.huffman_only, dict);
+    }
+
+    // Code a chunk of input as one or more blocks.
+    void code(const uint8_t* data, size_t size, vector<uint8_t>& out) {
+        _VectorSink sink{ out };
+        vector<vector<uint8_t>>& payloads =
+            encoder.encode_chunk(data, size, sizes, opt.huffman_only, opt.level, opt.window, nullptr, nullptr, dict);
+        for (size_t i = 0; i < sizes.size(); i++) {
+            uint32_t block_crc = crc32(data, sizes[i]);
+            index.push_back({ offset, total, block_crc });
+            offset += put_block(sink, (uint32_t)sizes[i], block_crc, payloads[i]);
+            crc = crc32_combine(crc, block_crc, sizes[i]);
+            total += sizes[i];
+            data += sizes[i];
+        }
+    }
+};
+
+HuffzipCompressor::HuffzipCompressor(const HuffzipOptions& options) : impl(new Impl) {
+    reset(options);
+}
+HuffzipCompressor::~HuffzipCompressor() = default;
+HuffzipCompressor::HuffzipCompressor(HuffzipCompressor&&) noexcept = default;
+HuffzipCompressor& HuffzipCompressor::operator=(HuffzipCompressor&&) noexcept = default;
+
+void HuffzipCompressor::reset() { reset(impl->opt); }
+
+bool HuffzipCompressor::reset(const HuffzipOptions& options) {
+    impl->clear();
+    HuffzipOptions& opt = impl->opt;
+    opt = options;
+    if (opt.block_size == 0) opt.block_size = max(DEFAULT_BLOCK_SIZE, (size_t)max(opt.window, 0));
+    if (opt.level < 1 || opt.level > 9) impl->error = "Invalid compression level";
+    else if (opt.window <= 0 || opt.window > MAX_WINDOW) impl->error = "Invalid window size";
+    else if (opt.block_size > MAX_BLOCK_SIZE) impl->error = "Invalid block size";
+    else if (opt.dictionary && opt.dictionary->id() == 0) impl->error = "Invalid dictionary";
+    impl->dict = opt.dictionary ? &opt.dictionary->impl->dict : nullptr;
+    return !impl->error;
+}
+
+bool HuffzipCompressor::write(const void* data, size_t size, vector<uint8_t>& out) {
+    Impl& s = *impl;
+    if (s.error) return false;
+    s.start(out);
+    const uint8_t* p = (const uint8_t*)data;
+    size_t block_size = s.opt.block_size;
+    while (size) {
+        if (s.pending.empty() && size >= block_size) {
+            s.code(p, block_size, out);
+            p += block_size;
+            size -= block_size;
+            continue;
+        }
+        size_t n = min(size, block_size - s.pending.size());
+        s.pending.insert(s.pending.end(), p, p + n);
+        p += n;
+        size -= n;
+        if (s.pending.size() == block_size) {
+            s.code(s.pending.data(), block_size, out);
+            s.pending.clear();
+        }
+    }
+    return true;
+}
+
+bool HuffzipCompressor::finish(vector<uint8_t>& out) {
+    Impl& s = *impl;
+    if (s.error) return false;
+    s.start(out);
+    if (!s.pending.empty()) s.code(s.pending.data(), s.pending.size(), out);
+    _VectorSink sink{ out };
+    put_footer(sink, s.index, s.crc, s.total, s.offset);
+    s.clear();
+    return true;
+}
+
+const char* HuffzipCompressor::error() const { return impl->error; }
+
+struct HuffzipDecompressor::Impl {
+    enum State { HEADER, BLOCK, INDEX_COUNT, INDEX, TRAILER, DONE };
+
+    BlockDecoder decoder;
+    vector<const Dictionary*> dicts;
+    vector<uint8_t> pending;      // partial header, block or trailer
+    State state = HEADER;
+    const Dictionary* dict = nullptr;
+    uint32_t blocks = 0;
+    uint64_t index_left = 0;      // index bytes still to skip
+    uint64_t offset = 0;          // bytes consumed so far
+    uint64_t index_offset = 0;
+    uint64_t total = 0;
+    uint32_t crc = 0;
+    const char* error = nullptr;
+
+    void clear() {
+        pending.clear();
+        state = HEADER;
+        blocks = 0;
+        index_left = 0;
+        offset = index_offset = 0;
+        total = 0;
+        crc = 0;
+        error = nullptr;
+    }
+
+    // Bytes needed for the next step given the `avail` bytes at p; 0 once the
+    // stream is done.
+    uint64_t need(const uint8_t* p, size_t avail) const {
+        switch (state) {
+        case HEADER: return avail > 4 && (p[4] & FLAG_DICTIONARY) ? HEADER_SIZE + 4 : HEADER_SIZE;
+        case BLOCK:
+            if (avail < 8) return 8;
+            if (load<uint32_t>(p) == 0) return 8;
+            return 4 + 4 + 4 + (uint64_t)load<uint32_t>(p + 4);
+        case INDEX_COUNT: return 4;
+        case INDEX: return 1;
+        case TRAILER: return TRAILER_SIZE;
+        default: return 0;
+        }
+    }
+
+    // Handle the next step from p, which holds at least need() bytes (any
+    // amount for INDEX); returns the bytes consumed, or 0 with `error` set.
+    size_t step(const uint8_t* p, size_t avail, vector<uint8_t>& out) {
+        size_t n = _step(p, avail, out);
+        offset += n;
+        return n;
+    }
+
+    size_t _step(const uint8_t* p, size_t avail, vector<uint8_t>& out) {
+        switch (state) {
+        case HEADER: {
+            uint8_t flag = p[4], version = p[5];
+            dict = nullptr;
+            if (load<uint32_t>(p) != SIGNATURE) error = "Invalid file signature";
+            else if (version != FORMAT_VERSION) error = "Unsupported format version";
+            else if (flag & FLAG_DICTIONARY) {
+                uint32_t id = load<uint32_t>(p + HEADER_SIZE);
+                for (const Dictionary* d : dicts)
+                    if (d->id == id) dict = d;
+                if (!dict) error = "Compressed with a dictionary that was not added";
+            }
+            if (error) return 0;
+            state = BLOCK;
+            return HEADER_SIZE + (dict ? 4 : 0);
+        }
+        case BLOCK: {
+            uint32_t raw_size = load<uint32_t>(p), payload_size = load<uint32_t>(p + 4);
+            if (raw_size == 0) {
+                state = INDEX_COUNT;
+                index_offset = offset + 8;
+                return 8;
+            }
+            uint32_t block_crc = load<uint32_t>(p + 8);
+            size_t start = out.size();
+            out.resize(start + raw_size);
+            if (!decoder.decode(p + 12, payload_size, raw_size, out.data() + start, nullptr, dict)) {
+                error = "Corrupt compressed data";
+                return 0;
+            }
+            if (crc32(out.data() + start, raw_size) != block_crc) {
+                error = "CRC mismatch";
+                return 0;
+            }
+            crc = crc32_combine(crc, block_crc, raw_size);
+            total += raw_size;
+            blocks++;
+            return 4 + 4 + 4 + (size_t)payload_size;
+        }
+        case INDEX_COUNT:
+            if (load<uint32_t>(p) != blocks) {
+                error = "Corrupt block index";
+                return 0;
+            }
+            index_left = (uint64_t)blocks * (8 + 8 + 4);
+            state = index_left ? INDEX : TRAILER;
+            return 4;
+        case INDEX: {
+            size_t n = (size_t)min<uint64_t>(avail, index_left);
+            index_left -= n;
+            if (index_left == 0) state = TRAILER;
+            return n;
+        }
+        case TRAILER:
+            if (load<uint64_t>(p + 4) != total) error = "Size mismatch";
+            else if (load<uint32_t>(p) != crc) error = "CRC mismatch";
+            else if (load<uint64_t>(p + 12) != index_offset || load<uint32_t>(p + 20) != blocks)
+                error = "Corrupt trailer";
+            else state = DONE;
+            return error ? 0 : TRAILER_SIZE;
+        default:
+            error = "Trailing data after the end of the stream";
+            return 0;
+        }
+    }
+
+    // Rejects block sizes no encoder writes, before buffering them.
+    bool check(const uint8_t* p, size_t avail) {
+        if (state != BLOCK || avail < 8) return true;
+        if (load<uint32_t>(p) > MAX_BLOCK_SIZE || load<uint32_t>(p + 4) > 2 * MAX_BLOCK_SIZE) {
+            error = "Corrupt compressed data";
+            return false;
+        }
+        return true;
+    }
+};
+
+HuffzipDecompressor::HuffzipDecompressor() : impl(new Impl) {}
+HuffzipDecompressor::~HuffzipDecompressor() = default;
+HuffzipDecompressor::HuffzipDecompressor(HuffzipDecompressor&&) noexcept = default;
+HuffzipDecompressor& HuffzipDecompressor::operator=(HuffzipDecompressor&&) noexcept = default;
+
+void HuffzipDecompressor::reset() { impl->clear(); }
+
+void HuffzipDecompressor::add_dictionary(const HuffzipDictionary& dictionary) {
+    impl->dicts.push_back(&dictionary.impl->dict);
+}
+
+bool HuffzipDecompressor::write(const void* data, size_t size, vector<uint8_t>& out) {
+    Impl& s = *impl;
+    if (s.error) return false;
+    const uint8_t* p = (const uint8_t*)data;
+    while (size) {
+        if (s.pending.empty()) {
+            // Whole steps straight from the caller's data.
+            if (!s.check(p, size)) return false;
+            uint64_t need = s.need(p, size);
+            if (need == 0) {
+                s.step(p, size, out);
+                return false;
+            }
+            if (need <= size) {
+                size_t n = s.step(p, size, out);
+                if (n == 0) return false;
+                p += n;
+                size -= n;
+                continue;
+            }
+        }
+        // Collect a step that straddles the end of the data.  The size may
+        // only be known once the first bytes of a block header are in.
+        uint64_t need = s.need(s.pending.data(), s.pending.size());
+        while (s.pending.size() < need && size) {
+            size_t n = (size_t)min<uint64_t>(size, need - s.pending.size());
+            s.pending.insert(s.pending.end(), p, p + n);
+            p += n;
+            size -= n;
+            if (!s.check(s.pending.data(), s.pending.size())) return false;
+            need = s.need(s.pending.data(), s.pending.size());
+        }
+        if (s.pending.size() < need) break;
+        if (s.step(s.pending.data(), s.pending.size(), out) == 0) return false;
+        s.pending.clear();
+    }
+    return true;
+}
+
+bool HuffzipDecompressor::finish(vector<uint8_t>&) {
+    Impl& s = *impl;
+    if (s.error) return false;
+    if (s.state != Impl::DONE) {
+        s.error = "Truncated input";
+        return false;
+    }
+    s.clear();
+    return true;
+}
+
+const char* HuffzipDecompressor::error() const { return impl->error; }
+
+bool huffzip_compress(HuffzipCompressor& ctx, const void* src, size_t size, vector<uint8_t>& dst) {
+    dst.clear();
+    ctx.reset();
+    return ctx.write(src, size, dst) && ctx.finish(dst);
+}
+
+bool huffzip_decompress(HuffzipDecompressor& ctx, const void* src, size_t size, vector<uint8_t>& dst) {
+    dst.clear();
+    ctx.reset();
+    return ctx.write(src, size, dst) && ctx.finish(dst);
+}
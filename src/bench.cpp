@@ -0,0 +1,325 @@
+#include <bits/stdc++.h>
+#include "bench.h"
+#include "crc32.h"
+#include "timer.h"
+#ifdef _WIN32
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+
+// Text: words from a small vocabulary, skewed towards the first ones.
+static vector<uint8_t> _corpus_text(mt19937& rng, size_t size) {
+    static const char* words[] = {
+        "the", "of", "and", "to", "in", "a", "is", "that", "for", "it", "as", "was", "with", "be",
+        "by", "on", "not", "he", "this", "are", "or", "his", "from", "at", "which", "but", "have",
+        "an", "had", "they", "you", "were", "their", "one", "all", "we", "can", "her", "has",
+        "there", "been", "if", "more", "when", "will", "would", "who", "so", "no", "compression",
+        "block", "window", "distance", "symbol", "frequency", "entropy", "stream", "table",
+    };
+    const uint32_t n = sizeof words / sizeof words[0];
+    vector<uint8_t> out;
+    out.reserve(size + 16);
+    int in_line = 0;
+    while (out.size() < size) {
+        uint32_t i = min(rng() % n, rng() % n);
+        for (const char* w = words[i]; *w; w++) out.push_back((uint8_t)*w);
+        uint32_t r = rng() % 16;
+        out.push_back(r == 0 ? ',' : r == 1 ? '.' : ' ');
+        if (++in_line == 12) {
+            out.push_back('\n');
+            in_line = 0;
+        }
+    }
+    out.resize(size);
+    return out;
+}
+
+// Binary: fixed-size records with a counter, small fields and a few
+// random bytes, as in a table dump.
+static vector<uint8_t> _corpus_records(mt19937& rng, size_t size) {
+    vector<uint8_t> out;
+    out.reserve(size + 32);
+    for (uint32_t id = 0; out.size() < size; id++) {
+        uint32_t fields[6] = { id, id * 7 / 3, (uint32_t)(rng() % 100), (uint32_t)(rng() % 4),
+            0xFFFF0000u, (uint32_t)rng() };
+        const uint8_t* p = (const uint8_t*)fields;
+        out.insert(out.end(), p, p + sizeof fields);
+    }
+    out.resize(size);
+    return out;
+}
+
+// Runs: long runs of one byte with occasional changes.
+static vector<uint8_t> _corpus_runs(mt19937& rng, size_t size) {
+    vector<uint8_t> out;
+    out.reserve(size);
+    while (out.size() < size) {
+        size_t run = min<size_t>(1 + rng() % 4096, size - out.size());
+        out.insert(out.end(), run, (uint8_t)(rng() % 4));
+    }
+    return out;
+}
+
+static vector<uint8_t> _corpus_random(mt19937& rng, size_t size) {
+    vector<uint8_t> out(size);
+    for (auto& b : out) b = (uint8_t)rng();
+    return out;
+}
+
+// Repeat: one random 64 KiB chunk over and over, so everything past the
+// first copy is a long match.
+static vector<uint8_t> _corpus_repeat(mt19937& rng, size_t size) {
+    vector<uint8_t> chunk = _corpus_random(rng, min<size_t>(size, 1 << 16));
+    vector<uint8_t> out(size);
+    for (size_t i = 0; i < size; i++) out[i] = chunk[i % chunk.size()];
+    return out;
+}
+
+vector<BenchInput> bench_corpus(size_t member_size) {
+    mt19937 rng(20240601);
+    vector<BenchInput> corpus;
+    corpus.push_back({ "text", _corpus_text(rng, member_size) });
+    corpus.push_back({ "records", _corpus_records(rng, member_size) });
+    corpus.push_back({ "runs", _corpus_runs(rng, member_size) });
+    corpus.push_back({ "random", _corpus_random(rng, member_size) });
+    corpus.push_back({ "repeat", _corpus_repeat(rng, member_size) });
+    corpus.push_back({ "tiny", _corpus_text(rng, 100) });
+    return corpus;
+}
+
+// Peak resident set size of the process in bytes (0 if unknown).
+static uint64_t _peak_rss() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (K32GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof pmc)) return pmc.PeakWorkingSetSize;
+    return 0;
+#else
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0) return 0;
+#ifdef __APPLE__
+    return (uint64_t)ru.ru_maxrss;
+#else
+    return (uint64_t)ru.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+struct BenchResult {
+    string name;
+    uint64_t raw_size = 0;
+    uint64_t comp_size = 0;
+    bool timed_read = false;
+    StageTime read, crc, verify, compress, decompress;
+    BlockTimes blocks;    // parse / build / encode from the fastest compression,
+                          // decode from the fastest decompression
+};
+
+static bool _bench_one(BenchInput& input, const StreamOptions& opt, int runs, BenchResult& r) {
+    const uint8_t* data = input.data.data();
+    size_t size = input.data.size();
+    r.name = input.name;
+    r.raw_size = size;
+
+    // One coder for every block and run, as each worker thread keeps one.
+    // The payloads are swapped out of the encoder rather than copied, so
+    // their buffers go back to it on the next run.
+    BlockEncoder encoder;
+    BlockDecoder decoder;
+    vector<vector<uint8_t>> payloads;
+    vector<uint32_t> crcs;
+    vector<size_t> sizes, block_sizes;
+    for (int run = 0; run < runs; run++) {
+        size_t count = 0;
+        crcs.clear();
+        block_sizes.clear();
+        BlockTimes times;
+        StageTime crc;
+        Stopwatch total, watch;
+        for (size_t off = 0; off < size; off += opt.block_size) {
+            size_t n = min(opt.block_size, size - off);
+            vector<vector<uint8_t>>& coded = encoder.encode_chunk(data + off, n, sizes, opt.huffman_only, opt.level,
+                opt.window, nullptr, &times, opt.dict);
+            const uint8_t* p = data + off;
+            for (size_t i = 0; i < sizes.size(); i++) {
+                watch.start();
+                crcs.push_back(crc32(p, sizes[i]));
+                crc.add(watch.lap());
+                block_sizes.push_back(sizes[i]);
+                if (count == payloads.size()) payloads.emplace_back();
+                swap(payloads[count++], coded[i]);
+                p += sizes[i];
+            }
+        }
+        StageTime t = total.lap();
+        payloads.resize(count);
+        if (run == 0 || t.seconds < r.compress.seconds) {
+            r.compress = t;
+            r.crc = crc;
+            r.blocks.parse = times.parse;
+            r.blocks.build = times.build;
+            r.blocks.encode = times.encode;
+        }
+    }
+    r.comp_size = 0;
+    for (auto& p : payloads) r.comp_size += BLOCK_HEADER_SIZE + p.size();
+
+    for (int run = 0; run < runs; run++) {
+        BlockTimes times;
+        StageTime verify;
+        Stopwatch total, watch;
+        string out;
+        size_t off = 0;
+        for (size_t b = 0; b < payloads.size(); b++) {
+            size_t n = block_sizes[b];
+            out.resize(n);
+            if (!decoder.decode(payloads[b].data(), payloads[b].size(), n, (uint8_t*)&out[0], &times, opt.dict))
+                return false;
+            watch.start();
+            bool ok = crc32(out.data(), out.size()) == crcs[b];
+            verify.add(watch.lap());
+            if (!ok || memcmp(out.data(), data + off, n) != 0) return false;
+            off += n;
+        }
+        StageTime t = total.lap();
+        if (run == 0 || t.seconds < r.decompress.seconds) {
+            r.decompress = t;
+            r.verify = verify;
+            r.blocks.decode = times.decode;
+        }
+    }
+    return true;
+}
+
+static void _print_stage(FILE* f, const char* name, const StageTime& t, uint64_t bytes) {
+    double mbs = t.seconds > 0 ? bytes / t.seconds / 1e6 : 0.0;
+    fprintf(f, "  %-12s %10.2f %10.1f", name, t.seconds * 1e3, mbs);
+    if (t.cycles > 0 && bytes > 0) fprintf(f, " %10.2f\n", (double)t.cycles / bytes);
+    else fprintf(f, " %10s\n", "-");
+}
+
+static void _print_table(FILE* f, const BenchResult& r) {
+    fprintf(f, "%s: %llu -> %llu bytes (%.4f)\n", r.name.c_str(), (unsigned long long)r.raw_size,
+        (unsigned long long)r.comp_size, r.raw_size > 0 ? (double)r.comp_size / r.raw_size : 0.0);
+    fprintf(f, "  %-12s %10s %10s %10s\n", "Stage", "ms", "MB/s", "cycles/B");
+    if (r.timed_read) _print_stage(f, "read", r.read, r.raw_size);
+    _print_stage(f, "crc", r.crc, r.raw_size);
+    _print_stage(f, "parse", r.blocks.parse, r.raw_size);
+    _print_stage(f, "build", r.blocks.build, r.raw_size);
+    _print_stage(f, "encode", r.blocks.encode, r.raw_size);
+    _print_stage(f, "compress", r.compress, r.raw_size);
+    _print_stage(f, "decode", r.blocks.decode, r.raw_size);
+    _print_stage(f, "verify", r.verify, r.raw_size);
+    _print_stage(f, "decompress", r.decompress, r.raw_size);
+}
+
+static string _json_string(const string& s) {
+    string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\', out += c;
+        else if ((unsigned char)c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof buf, "\\u%04x", c);
+            out += buf;
+        }
+        else out += c;
+    }
+    return out + "\"";
+}
+
+static void _json_stage(FILE* f, const char* name, const StageTime& t, uint64_t bytes, bool last = false) {
+    fprintf(f, "        %s: { \"ms\": %.3f, \"mb_s\": %.2f, \"cycles_per_byte\": %.3f }%s\n",
+        _json_string(name).c_str(), t.seconds * 1e3, t.seconds > 0 ? bytes / t.seconds / 1e6 : 0.0,
+        bytes > 0 ? (double)t.cycles / bytes : 0.0, last ? "" : ",");
+}
+
+static void _print_json(FILE* f, const vector<BenchResult>& results, const StreamOptions& opt, int runs,
+    uint64_t peak_rss) {
+    fprintf(f, "{\n");
+    fprintf(f, "  \"mode\": %s,\n", opt.huffman_only ? "\"huffman\"" : "\"lz77\"");
+    fprintf(f, "  \"level\": %d,\n", opt.level);
+    fprintf(f, "  \"window\": %d,\n", opt.window);
+    fprintf(f, "  \"block_size\": %llu,\n", (unsigned long long)opt.block_size);
+    fprintf(f, "  \"runs\": %d,\n", runs);
+    fprintf(f, "  \"peak_rss_bytes\": %llu,\n", (unsigned long long)peak_rss);
+    fprintf(f, "  \"files\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        fprintf(f, "    {\n");
+        fprintf(f, "      \"name\": %s,\n", _json_string(r.name).c_str());
+        fprintf(f, "      \"raw_size\": %llu,\n", (unsigned long long)r.raw_size);
+        fprintf(f, "      \"compressed_size\": %llu,\n", (unsigned long long)r.comp_size);
+        fprintf(f, "      \"stages\": {\n");
+        if (r.timed_read) _json_stage(f, "read", r.read, r.raw_size);
+        _json_stage(f, "crc", r.crc, r.raw_size);
+        _json_stage(f, "parse", r.blocks.parse, r.raw_size);
+        _json_stage(f, "build", r.blocks.build, r.raw_size);
+        _json_stage(f, "encode", r.blocks.encode, r.raw_size);
+        _json_stage(f, "compress", r.compress, r.raw_size);
+        _json_stage(f, "decode", r.blocks.decode, r.raw_size);
+        _json_stage(f, "verify", r.verify, r.raw_size);
+        _json_stage(f, "decompress", r.decompress, r.raw_size, true);
+        fprintf(f, "      }\n");
+        fprintf(f, "    }%s\n", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+}
+
+int run_bench(const vector<string>& files, const StreamOptions& opt, int runs, const string& json_path) {
+    FILE* log = json_path == "-" ? stderr : stdout;
+    vector<BenchResult> results;
+    vector<BenchInput> corpus;
+    if (files.empty()) corpus = bench_corpus();
+
+    size_t count = files.empty() ? corpus.size() : files.size();
+    for (size_t i = 0; i < count; i++) {
+        BenchResult r;
+        BenchInput input;
+        if (files.empty()) input = move(corpus[i]);
+        else {
+            input.name = files[i];
+            Stopwatch watch;
+            InputFile in;
+            if (!in.open(files[i])) {
+                fprintf(stderr, "Cannot open input file: %s\n", files[i].c_str());
+                return 1;
+            }
+            for (;;) {
+                Chunk c = in.take(IO_BUFFER_SIZE);
+                if (c.size == 0) break;
+                input.data.insert(input.data.end(), c.data, c.data + c.size);
+            }
+            if (in.failed()) {
+                fprintf(stderr, "Cannot read input file: %s\n", files[i].c_str());
+                return 1;
+            }
+            r.read = watch.lap();
+            r.timed_read = true;
+        }
+        if (!_bench_one(input, opt, runs, r)) {
+            fprintf(stderr, "Round trip failed: %s\n", input.name.c_str());
+            return 1;
+        }
+        _print_table(log, r);
+        results.push_back(move(r));
+    }
+
+    uint64_t peak_rss = _peak_rss();
+    fprintf(log, "Peak RSS: %.1f MiB\n", peak_rss / 1048576.0);
+    fflush(log);
+    if (!json_path.empty()) {
+        FILE* f = json_path == "-" ? stdout : fopen(json_path.c_str(), "w");
+        if (!f) {
+            fprintf(stderr, "Cannot open output file: %s\n", json_path.c_str());
+            return 1;
+        }
+        _print_json(f, results, opt, runs, peak_rss);
+        if (f != stdout && fclose(f) != 0) {
+            fprintf(stderr, "Cannot write output file: %s\n", json_path.c_str());
+            return 1;
+        }
+    }
+    return 0;
+}
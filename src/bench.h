@@ -0,0 +1,43 @@
+/*
+--bench: in-memory benchmark of the block coder.
+
+Each input (or, with no inputs, each member of a generated corpus) is loaded
+into memory, then compressed and decompressed `runs` times on one thread with
+the level, block size and mode given on the command line.  The fastest run of
+each direction is reported stage by stage:
+
+  read        loading the file (not timed for the generated corpus)
+  crc         CRC-32 of every block before compression
+  parse       LZ77 match finding and parsing, or the probe that skips it on
+              data without matches
+  build       block splitting, symbol counts and length-limited code
+              construction (a split chunk is parsed whole, and the blocks
+              that lose many matches to the cuts again on their own)
+  encode      code length headers and the coded data
+  decode      entropy decoding and LZ77 match copies
+  verify      CRC-32 of every decoded block
+
+with wall time, throughput over the input size, and cycles per input byte
+(time-stamp counter cycles, x86 only).  The round trip is checked byte for
+byte.  The report is a table on stdout; --json <file> also writes it as JSON
+("-" for stdout, which moves the table to stderr).
+
+bench_corpus(): the generated corpus (text, binary records, runs, random,
+    a repeated chunk, and a 100-byte text).  It is built from the raw output
+    of a fixed-seed mt19937, so it is identical on every platform and run;
+    the unit tests and the benchmark target use it too.
+*/
+
+#pragma once
+#include <bits/stdc++.h>
+#include "container.h"
+
+using namespace std;
+
+struct BenchInput {
+    string name;
+    vector<uint8_t> data;
+};
+
+vector<BenchInput> bench_corpus(size_t member_size = 1 << 20);
+int run_bench(const vector<string>& files, const StreamOptions& opt, int runs, const string& json_path);
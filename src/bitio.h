@@ -0,0 +1,214 @@
+/*
+Packed bit streams.
+
+BitWriter: appends codes of up to 64 bits to a byte buffer.  Bits collect in a
+64-bit accumulator; a flush stores all whole bytes with one 8-byte write, so
+unrolled loops can put several codes per flush with only a shift and an or
+each.
+BitReader: reads the same stream back.  The reader keeps up to 64 bits
+left-aligned in a buffer and refills 8 bytes at a time, so peek()/consume()
+never touch memory on the hot path.
+
+Bit order is MSB-first: the first bit written is the most significant bit of
+the first byte, and multi-bit values are written most significant bit first.
+The final byte is padded with zero bits.
+*/
+
+#pragma once
+#include <bits/stdc++.h>
+
+using namespace std;
+
+// Host <-> big-endian byte order for 64-bit words.
+static inline uint64_t _be64(uint64_t v) {
+#if defined(_MSC_VER)
+    return _byteswap_uint64(v);
+#elif __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return v;
+#else
+    return __builtin_bswap64(v);
+#endif
+}
+
+// Unaligned big-endian 8-byte load / store.
+static inline uint64_t _load_be64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return _be64(v);
+}
+
+static inline void _store_be64(uint8_t* p, uint64_t v) {
+    v = _be64(v);
+    memcpy(p, &v, 8);
+}
+
+// A code packed for BitWriter: the low `len` bits of `bits`, MSB first.
+struct BitCode {
+    uint64_t bits;
+    int len;
+};
+
+// Unchecked writer state for hot loops.  Held in a local, its fields live in
+// registers; BitWriter::sink() hands one out over pre-sized space and
+// BitWriter::commit() takes it back.
+struct BitSink {
+    uint8_t* p;
+    uint64_t acc;
+    int count;
+
+    // `bits` must fit in `n` bits; at most 57 bits between flush() calls.
+    void put(uint64_t bits, int n) {
+        acc = (acc << n) | bits;
+        count += n;
+    }
+
+    void flush() {
+        _store_be64(p, acc << (64 - count));
+        p += count >> 3;
+        count &= 7;
+    }
+};
+
+class BitWriter {
+public:
+    vector<uint8_t> out;
+
+    // Start a new stream, keeping the buffer's memory.
+    void clear() {
+        acc = 0;
+        count = 0;
+        pos = 0;
+    }
+
+    // Make room for about `bytes` of output up front.
+    void reserve(size_t bytes) {
+        if (out.size() < bytes + 8) out.resize(bytes + 8);
+    }
+
+    // Append the low `n` bits of `bits` (n <= 64).
+    void write(uint64_t bits, int n) {
+        if (n > 56) {
+            write(bits >> 32, n - 32);
+            n = 32;
+        }
+        if (count + n > 64) flush();
+        put(bits & ((1ull << n) - 1), n);
+    }
+
+    // Unchecked append for unrolled loops: `bits` must fit in `n` bits, and
+    // at most 57 bits may be put between flush() calls.
+    void put(uint64_t bits, int n) {
+        acc = (acc << n) | bits;
+        count += n;
+    }
+
+    // Store every whole byte of the accumulator with one unaligned 8-byte
+    // big-endian store; at most 7 bits stay behind.
+    void flush() {
+        if (pos + 8 > out.size()) out.resize(max<size_t>(64, 2 * out.size()));
+        if (count == 0) return;
+        _store_be64(out.data() + pos, acc << (64 - count));
+        pos += count >> 3;
+        count &= 7;
+    }
+
+    // Writer state with room for at least `bytes` more bytes.
+    BitSink sink(size_t bytes) {
+        flush();
+        reserve(pos + bytes + 8);
+        return { out.data() + pos, acc, count };
+    }
+
+    void commit(const BitSink& s) {
+        pos = s.p - out.data();
+        acc = s.acc;
+        count = s.count;
+    }
+
+    // Number of bits written so far.
+    uint64_t bit_count() const { return (uint64_t)pos * 8 + count; }
+
+    // Zero-pad to a byte boundary; everything written so far is then in
+    // out[0, bit_count() / 8).
+    void align() {
+        flush();
+        if (count > 0) out[pos++] = (uint8_t)(acc << (8 - count));
+        count = 0;
+        acc = 0;
+    }
+
+    // Flush the remaining bits, zero-padding the last byte.
+    vector<uint8_t>& finish() {
+        align();
+        out.resize(pos);
+        return out;
+    }
+
+private:
+    uint64_t acc = 0;  // pending bits in the low `count` positions
+    int count = 0;     // at most 64
+    size_t pos = 0;    // bytes of `out` already written
+};
+
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t size)
+        : data(data), ptr(data), end(data + size) {
+        refill();
+    }
+
+    // Make at least 56 bits available.  Bits past the end of the input read
+    // as zero; overrun() reports whether any of them were consumed.
+    void refill() {
+        if (end - ptr >= 8) {
+            buf |= _load_be64(ptr) >> count;
+            ptr += (63 - count) >> 3;
+            count |= 56;
+            return;
+        }
+        while (count <= 56) {
+            uint64_t b = 0;
+            if (ptr < end) b = *ptr++;
+            else padding++;
+            buf |= b << (56 - count);
+            count += 8;
+        }
+    }
+
+    // Make at least `n` bits (n <= 56) available.
+    void ensure(int n) {
+        if (count < n) refill();
+    }
+
+    // Next `n` bits (1 <= n <= 56) without consuming them.  Call ensure()
+    // first if fewer than `n` bits may be buffered.
+    uint64_t peek(int n) const { return buf >> (64 - n); }
+
+    void consume(int n) {
+        buf <<= n;
+        count -= n;
+    }
+
+    // Read `n` bits (0 <= n <= 56).
+    uint64_t read(int n) {
+        if (n == 0) return 0;
+        if (count < n) refill();
+        uint64_t v = peek(n);
+        consume(n);
+        return v;
+    }
+
+    // Bits consumed so far.
+    uint64_t bit_pos() const { return (uint64_t)(ptr - data + padding) * 8 - count; }
+
+    // True once more bits were consumed than the input holds.
+    bool overrun() const { return bit_pos() > (uint64_t)(end - data) * 8; }
+
+private:
+    const uint8_t* data;
+    const uint8_t* ptr;   // next byte to load into buf
+    const uint8_t* end;
+    size_t padding = 0;   // zero bytes loaded past `end`
+    uint64_t buf = 0;     // left-aligned; the top `count` bits are valid
+    int count = 0;
+};
@@ -0,0 +1,469 @@
+#include <bits/stdc++.h>
+#include "block.h"
+
+using namespace std;
+
+// split_block: the granularity of the cuts, an estimate of the code length
+// header per symbol used, and the estimated saving that pays for a cut (the
+// block header, and matches that can no longer reach across it).
+const size_t SPLIT_SEGMENT     = 16 << 10;
+const double SPLIT_HEADER_BITS = 4;
+const double SPLIT_COST        = 2048;
+
+// BlockEncoder::encode_chunk: a block that lost more than 1/CUT_REPARSE of its
+// bytes to matches reaching across a cut is parsed again on its own.
+const size_t CUT_REPARSE       = 32;
+
+// BlockEncoder::few_matches: blocks smaller than PROBE_MIN_SIZE are parsed
+// without asking (the parse is cheap, and the sample too small to judge).
+const size_t PROBE_MIN_SIZE    = 16 << 10;
+const int    PROBE_SAMPLE_BITS = 4;
+const int    PROBE_HASH_BITS   = 16;
+
+// Huffman-only blocks from this size on are coded in four streams
+// (encode_bytes4), which decode about twice as fast; below it the jump table
+// is not worth its bytes.
+const size_t HUFFMAN_STREAMS_MIN_SIZE = 16 << 10;
+
+// tANS is tried only on symbols whose Huffman codes spend more than this
+// fraction over their entropy; closer than that it saves too little to pay
+// for encoding about four times slower.
+const double FSE_MIN_GAIN = 0.01;
+
+// Estimated coded bits of a block with byte counts `freq` summing to `n`: the
+// order-0 entropy plus a rough code length header, and never more than
+// storing it.
+static double _split_cost(const uint32_t* freq, size_t n) {
+    double bits = 0;
+    for (int s = 0; s < 256; s++)
+        if (freq[s]) bits += freq[s] * log2((double)n / freq[s]) + SPLIT_HEADER_BITS;
+    return min(bits, 8.0 * n);
+}
+
+// Add the symbol counts of LZ77 tokens to `freq` and `dist_freq`, and their
+// extra bits to `extra_bits`.
+static void _count_tokens(const vector<LZToken>& tokens, uint32_t* freq, uint32_t* dist_freq,
+    uint64_t& extra_bits) {
+    for (auto& t : tokens) {
+        if (t.is_literal) freq[(unsigned char)t.literal]++;
+        else {
+            int lc = length_code(t.length), dc = dist_code(t.distance);
+            freq[256 + lc]++;
+            dist_freq[dc]++;
+            extra_bits += LENGTH_CODES[lc].extra + DIST_CODES[dc].extra;
+        }
+    }
+}
+
+// Estimated coded bits of a block of `n` bytes parsed into `tokens`, as
+// _split_cost estimates bytes: the entropy of the literal/length and distance
+// symbols, their extra bits and a rough header, and never more than storing
+// it.
+static double _token_cost(const vector<LZToken>& tokens, size_t n) {
+    uint32_t freq[NUM_SYMBOLS] = {}, dist_freq[NUM_DIST_SYMBOLS] = {};
+    uint64_t extra_bits = 0;
+    _count_tokens(tokens, freq, dist_freq, extra_bits);
+    double bits = (double)extra_bits;
+    auto entropy = [&bits](const uint32_t* f, int symbols) {
+        double total = 0;
+        for (int s = 0; s < symbols; s++) total += f[s];
+        for (int s = 0; s < symbols; s++)
+            if (f[s]) bits += f[s] * log2(total / f[s]) + SPLIT_HEADER_BITS;
+    };
+    entropy(freq, NUM_SYMBOLS);
+    entropy(dist_freq, NUM_DIST_SYMBOLS);
+    return min(bits, 8.0 * n);
+}
+
+void split_block(const uint8_t* data, size_t size, vector<size_t>& sizes) {
+    sizes.clear();
+    uint32_t block[256] = {}, segment[256], joined[256];
+    size_t block_size = 0;
+    double block_cost = 0;
+    for (size_t pos = 0; pos < size;) {
+        size_t n = size - pos < 2 * SPLIT_SEGMENT ? size - pos : SPLIT_SEGMENT;
+        memset(segment, 0, sizeof segment);
+        histogram(data + pos, n, segment);
+        for (int s = 0; s < 256; s++) joined[s] = block[s] + segment[s];
+        double segment_cost = _split_cost(segment, n), joined_cost = _split_cost(joined, block_size + n);
+        if (block_size && block_cost + segment_cost + SPLIT_COST < joined_cost) {
+            sizes.push_back(block_size);
+            memcpy(block, segment, sizeof block);
+            block_size = n;
+            block_cost = segment_cost;
+        }
+        else {
+            memcpy(block, joined, sizeof block);
+            block_size += n;
+            block_cost = joined_cost;
+        }
+        pos += n;
+    }
+    if (block_size) sizes.push_back(block_size);
+}
+
+// Block coder state kept between blocks: the LZ77 parser and the output
+// buffers keep their memory, so coding blocks of one size allocates nothing
+// after the first.  One encoder per thread.
+vector<uint8_t>& BlockEncoder::encode(const uint8_t* data, size_t size, bool huffman_only, int level,
+    int window, BlockStats* stats, BlockTimes* times,
+    const Dictionary* dict) {
+    Stopwatch watch;
+    // Data LZ77 finds (almost) no matches in is not worth parsing.
+    bool lz = !huffman_only && (size < PROBE_MIN_SIZE || !few_matches(dict, data, size));
+    static const vector<LZToken> no_tokens;
+    const vector<LZToken>& tokens = lz ? parse(data, size, level, window, dict) : no_tokens;
+    if (times) times->parse.add(watch.lap());
+    return encode_tokens(data, size, lz, tokens, stats, times, dict);
+}
+
+vector<vector<uint8_t>>& BlockEncoder::encode_chunk(const uint8_t* data, size_t size, vector<size_t>& sizes,
+    bool huffman_only, int level, int window, BlockStats* stats,
+    BlockTimes* times, const Dictionary* dict) {
+    Stopwatch watch;
+    split_block(data, size, sizes);
+    if (times) times->build.add(watch.lap());
+    payloads.resize(sizes.size());
+    const uint8_t* p = data;
+    // One block is coded as it is; the blocks of a chunk the probe finds
+    // next to no matches in are not parsed.
+    if (sizes.size() == 1 || huffman_only || few_matches(dict, data, size)) {
+        if (times) times->parse.add(watch.lap());
+        for (size_t i = 0; i < sizes.size(); i++) {
+            payloads[i].swap(encode(p, sizes[i], huffman_only || sizes.size() > 1, level, window, stats,
+                times, dict));
+            p += sizes[i];
+        }
+        return payloads;
+    }
+
+    const vector<LZToken>& tokens = parse(data, size, level, window, dict);
+    if (times) times->parse.add(watch.lap());
+    cut_tokens(data, tokens, sizes);
+    double split_cost = 8.0 * BLOCK_HEADER_SIZE * (sizes.size() - 1);
+    for (size_t i = 0; i < sizes.size(); i++) split_cost += _token_cost(block_tokens[i], sizes[i]);
+    if (times) times->build.add(watch.lap());
+    if (split_cost >= _token_cost(tokens, size)) {
+        sizes.assign(1, size);
+        payloads.resize(1);
+        payloads[0].swap(encode_tokens(data, size, true, tokens, stats, times, dict));
+        return payloads;
+    }
+    for (size_t i = 0; i < sizes.size(); i++) {
+        payloads[i].swap(cut_bytes[i] * CUT_REPARSE > sizes[i]
+            ? encode(p, sizes[i], false, level, window, stats, times, dict)
+            : encode_tokens(p, sizes[i], true, block_tokens[i], stats, times, dict));
+        p += sizes[i];
+    }
+    return payloads;
+}
+
+const vector<LZToken>& BlockEncoder::parse(const uint8_t* data, size_t size, int level, int window,
+    const Dictionary* dict) {
+    if (!dict || dict->content.empty()) return parser.parse(data, size, level, window);
+    joined.assign(dict->content.begin(), dict->content.end());
+    joined.insert(joined.end(), data, data + size);
+    return parser.parse(joined.data(), joined.size(), level, window, MAX_MATCH, dict->content.size());
+}
+
+void BlockEncoder::cut_tokens(const uint8_t* data, const vector<LZToken>& tokens, const vector<size_t>& sizes) {
+    block_tokens.resize(sizes.size());
+    for (auto& b : block_tokens) b.clear();
+    cut_bytes.assign(sizes.size(), 0);
+    size_t k = 0, start = 0, end = sizes[0], pos = 0;
+    for (auto& t : tokens) {
+        size_t length = t.is_literal ? 1 : t.length;
+        while (length) {
+            while (pos == end) {
+                start = end;
+                end += sizes[++k];
+            }
+            size_t n = min(length, end - pos);
+            vector<LZToken>& out = block_tokens[k];
+            if (t.is_literal) {
+                out.push_back(t);
+                pos++;
+                length--;
+                continue;
+            }
+            // Bytes of the match kept, and its distance inside the block.
+            size_t kept = 0;
+            int distance = t.distance;
+            if (start == 0 || pos >= start + t.distance) kept = n;
+            else if (pos < (size_t)t.distance) {
+                // Copied from the dictionary: only up to its end, as
+                // the block's own data follows it instead of the chunk's.
+                kept = min(n, (size_t)t.distance - pos);
+                distance -= (int)start;
+            }
+            if (kept < (size_t)MIN_MATCH) kept = 0;
+            else out.push_back({ false, 0, distance, (int)kept });
+            for (size_t i = pos + kept; i < pos + n; i++) out.push_back({ true, (char)data[i], 0, 0 });
+            cut_bytes[k] += n - kept;
+            pos += n;
+            length -= n;
+        }
+    }
+}
+
+vector<uint8_t>& BlockEncoder::encode_tokens(const uint8_t* data, size_t size, bool lz, const vector<LZToken>& tokens,
+    BlockStats* stats, BlockTimes* times, const Dictionary* dict) {
+    uint32_t byte_freq[NUM_SYMBOLS] = {};
+    uint32_t freq[NUM_SYMBOLS] = {};
+    uint32_t dist_freq[NUM_DIST_SYMBOLS] = {};
+    uint64_t extra_bits = 0;
+    Stopwatch watch;
+    if (lz) _count_tokens(tokens, freq, dist_freq, extra_bits);
+    histogram(data, size, byte_freq);
+
+    CodeTable byte_table, table, dist_table;
+    build_code_table(byte_freq, NUM_SYMBOLS, MAX_CODE_LEN, byte_table);
+    if (lz) {
+        build_code_table(freq, NUM_SYMBOLS, MAX_CODE_LEN, table);
+        build_code_table(dist_freq, NUM_DIST_SYMBOLS, MAX_CODE_LEN, dist_table);
+    }
+
+    // The Huffman codings are costed exactly from the frequencies, tANS
+    // to within a fraction of a percent; the headers are sized by writing
+    // them.
+    auto header_bits = [&](const CodeTable& t, int n) {
+        encoded.clear();
+        write_code_lengths(encoded, t.len, n);
+        return encoded.bit_count();
+    };
+    auto fse_header_bits = [&](const FseTable& t) {   // the counts, and the encoder's final state
+        encoded.clear();
+        write_fse_counts(encoded, t);
+        return encoded.bit_count() + t.table_log;
+    };
+    auto sum_bits = [](const uint32_t* f, const CodeTable& t, int n) {
+        uint64_t bits = 0;
+        for (int i = 0; i < n; i++) bits += (uint64_t)f[i] * t.len[i];
+        return bits;
+    };
+    uint64_t type_bits = dict ? 2 : 1;   // block type, then own or shared tables
+    uint64_t own_bits = type_bits + 1;   // and the coder of a block with its own tables
+    // Huffman-only blocks say whether they use four streams; those are
+    // costed at most: the jump table, and padding to a byte before it and
+    // after each stream.
+    bool streams = size >= HUFFMAN_STREAMS_MIN_SIZE;
+    uint64_t streams_bits = 1 + (streams ? 7 + 8 * JUMP_TABLE_SIZE + 4 * 7 : 0);
+    Choice best = { false, false, false, &byte_table, nullptr,
+        own_bits + streams_bits + header_bits(byte_table, NUM_SYMBOLS) + sum_bits(byte_freq, byte_table, 256) };
+    auto consider = [&](const Choice& c) { if (c.bits < best.bits) best = c; };
+    if (dict)
+        consider({ false, true, false, &dict->bytes, nullptr,
+            type_bits + streams_bits + sum_bits(byte_freq, dict->bytes, 256) });
+    if (lz) {
+        consider({ true, false, false, &table, &dist_table,
+            own_bits + header_bits(table, NUM_SYMBOLS) + header_bits(dist_table, NUM_DIST_SYMBOLS) + extra_bits
+                + sum_bits(freq, table, NUM_SYMBOLS) + sum_bits(dist_freq, dist_table, NUM_DIST_SYMBOLS) });
+        if (dict)
+            consider({ true, true, false, &dict->lit, &dict->dist,
+                type_bits + extra_bits + sum_bits(freq, dict->lit, NUM_SYMBOLS)
+                    + sum_bits(dist_freq, dict->dist, NUM_DIST_SYMBOLS) });
+    }
+    Choice huffman = best;
+    if (sum_bits(byte_freq, byte_table, 256) > (1 + FSE_MIN_GAIN) * entropy_bits(byte_freq, 256)) {
+        build_fse_table(byte_freq, 256, FSE_MAX_TABLE_LOG, fse_bytes);
+        consider({ false, false, true, &byte_table, nullptr,
+            own_bits + fse_header_bits(fse_bytes) + fse_bytes.table_log
+                + (uint64_t)ceil(fse_data_bits(byte_freq, fse_bytes)) });
+    }
+    if (lz && sum_bits(freq, table, NUM_SYMBOLS) + sum_bits(dist_freq, dist_table, NUM_DIST_SYMBOLS)
+            > (1 + FSE_MIN_GAIN) * (entropy_bits(freq, NUM_SYMBOLS) + entropy_bits(dist_freq, NUM_DIST_SYMBOLS))) {
+        build_fse_table(freq, NUM_SYMBOLS, FSE_MAX_TABLE_LOG, fse_lit);
+        build_fse_table(dist_freq, NUM_DIST_SYMBOLS, FSE_MAX_TABLE_LOG, fse_dist);
+        consider({ true, false, true, &table, &dist_table,
+            own_bits + fse_header_bits(fse_lit) + fse_header_bits(fse_dist) + extra_bits
+                + (uint64_t)ceil(fse_data_bits(freq, fse_lit) + fse_data_bits(dist_freq, fse_dist)) });
+    }
+    if (times) times->build.add(watch.lap());
+
+    // A block that does not shrink is stored: its payload is the data.
+    auto store = [&]() -> vector<uint8_t>& {
+        stored.assign(data, data + size);
+        if (times) times->encode.add(watch.lap());
+        if (stats) stats->stored_blocks++;
+        return stored;
+    };
+    if ((best.bits + 7) / 8 >= size) return store();
+    write_payload(best, data, size, tokens, streams, dict);
+    // tANS may come out a little over its estimate, past the Huffman coding.
+    if (best.fse && encoded.bit_count() > huffman.bits) {
+        best = huffman;
+        write_payload(best, data, size, tokens, streams, dict);
+    }
+    if ((encoded.bit_count() + 7) / 8 >= size) return store();
+    if (times) times->encode.add(watch.lap());
+
+    if (stats) {
+        const uint32_t* f = best.lz ? freq : byte_freq;
+        const CodeTable* lt = best.lit;
+        const CodeTable* dt = best.dist;
+        (best.lz ? stats->lz_blocks : stats->huffman_blocks)++;
+        int unbounded[NUM_SYMBOLS];
+        tree_code_lengths(f, NUM_SYMBOLS, unbounded);
+        for (int i = 0; i < NUM_SYMBOLS; i++) {
+            stats->freq[i] += f[i];
+            if (f[i]) stats->max_len = max(stats->max_len, (int)lt->len[i]);
+            stats->unbounded_max_len = max(stats->unbounded_max_len, unbounded[i]);
+            stats->coded_bits += (uint64_t)f[i] * lt->len[i];
+            stats->unbounded_bits += (uint64_t)f[i] * unbounded[i];
+        }
+        for (int i = 0; i < NUM_DIST_SYMBOLS && best.lz; i++) {
+            stats->dist_bits += (uint64_t)dist_freq[i] * (dt->len[i] + DIST_CODES[i].extra);
+            stats->matches += dist_freq[i];
+        }
+        if (best.fse) {
+            stats->fse_blocks++;
+            stats->fse_bits += (uint64_t)(best.lz ? fse_data_bits(freq, fse_lit) + fse_data_bits(dist_freq, fse_dist)
+                                                  : fse_data_bits(byte_freq, fse_bytes));
+            stats->fse_huffman_bits += best.lz
+                ? sum_bits(freq, table, NUM_SYMBOLS) + sum_bits(dist_freq, dist_table, NUM_DIST_SYMBOLS)
+                : sum_bits(byte_freq, byte_table, 256);
+        }
+    }
+    return encoded.finish();
+}
+
+void BlockEncoder::write_payload(const Choice& c, const uint8_t* data, size_t size, const vector<LZToken>& tokens,
+    bool streams, const Dictionary* dict) {
+    encoded.clear();
+    encoded.reserve(c.bits / 8 + 8);
+    encoded.write(c.lz, 1);
+    if (dict) encoded.write(c.shared, 1);
+    if (!c.shared) encoded.write(c.fse, 1);
+    if (c.fse) {
+        if (c.lz) {
+            write_fse_counts(encoded, fse_lit);
+            write_fse_counts(encoded, fse_dist);
+            fse_encode_tokens(fse_lit, fse_dist, tokens, encoded, fse_scratch);
+        }
+        else {
+            write_fse_counts(encoded, fse_bytes);
+            fse_encode_bytes(fse_bytes, data, size, encoded, fse_scratch);
+        }
+        return;
+    }
+    if (!c.lz) encoded.write(streams, 1);
+    if (!c.shared) {
+        write_code_lengths(encoded, c.lit->len, NUM_SYMBOLS);
+        if (c.lz) write_code_lengths(encoded, c.dist->len, NUM_DIST_SYMBOLS);
+    }
+    const CodeTable* lt = c.lit;
+    const CodeTable* dt = c.dist;
+    if (!c.lz) {
+        if (streams) encode_bytes4(*lt, data, size, encoded);
+        else encode_bytes(*lt, data, size, encoded);
+        return;
+    }
+    for (auto& t : tokens) {
+        if (t.is_literal) {
+            unsigned char ch = (unsigned char)t.literal;
+            encoded.write(lt->code[ch], lt->len[ch]);
+        }
+        else {
+            int lsym = 256 + length_code(t.length);
+            encoded.write(lt->code[lsym], lt->len[lsym]);
+            encoded.write(t.length - LENGTH_CODES[lsym - 256].base, LENGTH_CODES[lsym - 256].extra);
+            int dsym = dist_code(t.distance);
+            encoded.write(dt->code[dsym], dt->len[dsym]);
+            encoded.write(t.distance - DIST_CODES[dsym].base, DIST_CODES[dsym].extra);
+        }
+    }
+}
+
+bool BlockEncoder::few_matches(const Dictionary* dict, const uint8_t* data, size_t size) {
+    if (++probe_generation == 1) probe.assign((size_t)1 << PROBE_HASH_BITS, 0);
+    uint64_t* table = probe.data();
+    uint64_t tag = (uint64_t)probe_generation << 48;
+    auto scan = [table, tag](const uint8_t* p, const uint8_t* end) {
+        uint64_t hits = 0;
+        for (; p + 8 <= end; p++) {
+            uint64_t v;
+            memcpy(&v, p, 8);
+            v &= 0xFFFFFFFFFFFFull;
+            uint64_t h = v * 0x9E3779B97F4A7C15ull;
+            if (h >> (64 - PROBE_SAMPLE_BITS)) continue;
+            uint64_t& slot = table[(h >> (64 - PROBE_SAMPLE_BITS - PROBE_HASH_BITS)) & ((1 << PROBE_HASH_BITS) - 1)];
+            hits += slot == (v | tag);
+            slot = v | tag;
+        }
+        return hits;
+    };
+    if (dict) scan(dict->content.data(), dict->content.data() + dict->content.size());
+    uint64_t hits = scan(data, data + size);
+    return (hits << PROBE_SAMPLE_BITS) * 256 < size;
+}
+
+bool BlockDecoder::decode(const uint8_t* payload, size_t payload_size, size_t raw_size, uint8_t* dst,
+    BlockTimes* times, const Dictionary* dict) {
+    Stopwatch watch;
+    if (payload_size == raw_size) {
+        memcpy(dst, payload, raw_size);
+        if (times) times->decode.add(watch.lap());
+        return true;
+    }
+    BitReader bits(payload, payload_size);
+
+    bool lz = bits.read(1);
+    bool shared = dict && bits.read(1);
+    bool fse = !shared && bits.read(1);
+    const uint8_t* history = dict ? dict->content.data() : nullptr;
+    size_t history_size = dict ? dict->content.size() : 0;
+    if (fse) {
+        int log;
+        bool ok;
+        if (!read_fse_counts(bits, lz ? NUM_SYMBOLS : 256, norm, log)) return false;
+        fse_decoder.build(norm, lz ? NUM_SYMBOLS : 256, log);
+        if (!lz) ok = fse_decode_bytes(fse_decoder, bits, dst, raw_size);
+        else {
+            if (!read_fse_counts(bits, NUM_DIST_SYMBOLS, norm, log)) return false;
+            fse_dist_decoder.build(norm, NUM_DIST_SYMBOLS, log);
+            FseState lit_state(fse_decoder, bits), dist_state(fse_dist_decoder, bits);
+            ok = decode_lz77(lit_state, dist_state, bits, dst, raw_size, history, history_size);
+        }
+        if (times) times->decode.add(watch.lap());
+        return ok;
+    }
+    bool streams = !lz && bits.read(1);
+    const HuffDecoder* lit = &decoder;
+    const HuffDecoder* dist = &dist_decoder;
+    if (shared) {
+        lit = lz ? &dict->lit_decoder : &dict->byte_decoder;
+        dist = &dict->dist_decoder;
+    }
+    else if (!read_code_lengths(bits, NUM_SYMBOLS, lengths) || !decoder.build(lengths, NUM_SYMBOLS))
+        return false;
+
+    if (!lz) {
+        bool ok;
+        if (streams) {
+            size_t start = (size_t)((bits.bit_pos() + 7) / 8);
+            ok = !bits.overrun() && decode_huffman4(*lit, payload + start, payload_size - start, dst, raw_size);
+        }
+        else ok = decode_huffman(*lit, bits, dst, raw_size) == raw_size && !bits.overrun();
+        if (times) times->decode.add(watch.lap());
+        return ok;
+    }
+    if (!shared && (!read_code_lengths(bits, NUM_DIST_SYMBOLS, lengths)
+                       || !dist_decoder.build(lengths, NUM_DIST_SYMBOLS)))
+        return false;
+    bool ok = decode_lz77(*lit, *dist, bits, dst, raw_size, history, history_size);
+    if (times) times->decode.add(watch.lap());
+    return ok;
+}
+
+vector<uint8_t> compress_block(const uint8_t* data, size_t size, bool huffman_only, int level,
+    int window, BlockStats* stats, BlockTimes* times) {
+    BlockEncoder encoder;
+    return move(encoder.encode(data, size, huffman_only, level, window, stats, times));
+}
+
+bool decompress_block(const uint8_t* payload, size_t payload_size, size_t raw_size, string& out,
+    BlockTimes* times) {
+    BlockDecoder decoder;
+    out.resize(raw_size);
+    return decoder.decode(payload, payload_size, raw_size, (uint8_t*)&out[0], times);
+}
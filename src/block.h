@@ -0,0 +1,196 @@
+/*
+Compression and decompression of a single block.
+
+A block is an independent unit of the stream: it carries its own code length
+header and its LZ77 matches never reach outside it, so blocks can be coded
+and decoded with memory proportional to the block size.  With a dictionary
+(dictionary.cpp) matches may also reach into the dictionary content, and a
+block may use the dictionary's tables instead of its own.
+
+BlockEncoder: codes one block whichever way is smallest.  The payload of a
+                coded block starts with one bit, 0 for Huffman-only and 1 for
+                LZ77; a block with its own tables has a second bit, 0 for
+                Huffman codes and 1 for tANS (fse.cpp), and a Huffman-coded
+                Huffman-only block a third, 1 if its data is in four streams.
+                Then come the code lengths or tANS counts (LZ blocks carry a
+                second table for the distance symbols) and the encoded data,
+                padded to a byte.  A block that would not shrink
+                is stored: its payload is the raw data, so a payload as long as
+                the block marks it, and it decodes with a memcpy.
+BlockDecoder: decodes a payload back into exactly `raw_size` bytes.
+Both keep their tables and buffers between blocks; compress_block and
+decompress_block are one-shot wrappers.
+BlockEncoder::encode_chunk cuts a chunk of input into blocks where its byte
+statistics shift (split_block), so data that changes character (text, then
+an embedded image, then zeros) gets tables for each part, and incompressible
+parts are stored.  Blocks a quick sampled probe finds no repeats in skip the
+LZ77 parse, the costliest stage, and are Huffman coded or stored.
+*/
+
+#pragma once
+#include <bits/stdc++.h>
+#include "dictionary.h"
+#include "fse.h"
+#include "timer.h"
+
+using namespace std;
+
+const size_t DEFAULT_BLOCK_SIZE = 1 << 20;
+const size_t MAX_BLOCK_SIZE     = 1 << 30;
+const size_t BLOCK_HEADER_SIZE  = 4 + 4 + 4;   // in the container: raw size, payload size, CRC-32
+
+// Per-block coding statistics, summed over the stream for -v output.
+struct BlockStats {
+    vector<long long> freq = vector<long long>(NUM_SYMBOLS, 0);  // symbol counts
+    uint64_t coded_bits = 0;       // data bits with the length-limited codes
+    uint64_t unbounded_bits = 0;   // data bits with unbounded Huffman codes
+    uint64_t dist_bits = 0;        // distance codes plus their extra bits
+    long long matches = 0;
+    long long stored_blocks = 0, huffman_blocks = 0, lz_blocks = 0;   // blocks coded each way
+    long long fse_blocks = 0;      // of the coded blocks, those coded with tANS
+    uint64_t fse_bits = 0;         // their data bits with tANS (estimated)
+    uint64_t fse_huffman_bits = 0; // and with their Huffman codes
+    int max_len = 0;               // longest code used
+    int unbounded_max_len = 0;     // longest code without the limit
+
+    void add(const BlockStats& o) {
+        for (int i = 0; i < NUM_SYMBOLS; i++) freq[i] += o.freq[i];
+        coded_bits += o.coded_bits;
+        unbounded_bits += o.unbounded_bits;
+        dist_bits += o.dist_bits;
+        matches += o.matches;
+        stored_blocks += o.stored_blocks;
+        huffman_blocks += o.huffman_blocks;
+        lz_blocks += o.lz_blocks;
+        fse_blocks += o.fse_blocks;
+        fse_bits += o.fse_bits;
+        fse_huffman_bits += o.fse_huffman_bits;
+        max_len = max(max_len, o.max_len);
+        unbounded_max_len = max(unbounded_max_len, o.unbounded_max_len);
+    }
+};
+
+// Time spent in each stage of the block coder, summed over blocks (--bench).
+struct BlockTimes {
+    StageTime parse;     // LZ77 match finding and parsing, or the match probe
+    StageTime build;     // symbol counts and code construction
+    StageTime encode;    // code length headers and the coded data
+    StageTime decode;    // entropy decoding and LZ77 match copies
+
+    void add(const BlockTimes& o) {
+        parse.add(o.parse);
+        build.add(o.build);
+        encode.add(o.encode);
+        decode.add(o.decode);
+    }
+};
+
+// Cut data[0, size) into the blocks to code, where the byte statistics shift.
+// Segments of SPLIT_SEGMENT bytes are taken in order; each one starts a new
+// block when coding it apart from the block so far is estimated to save more
+// than SPLIT_COST bits, and joins it otherwise.  Sets `sizes` to the block
+// sizes.
+void split_block(const uint8_t* data, size_t size, vector<size_t>& sizes);
+
+class BlockEncoder {
+public:
+    // Code one block the cheapest way: LZ77 (unless huffman_only) or
+    // Huffman-only, each with its own Huffman or tANS tables or the
+    // dictionary's Huffman tables, or stored.
+    // The payload stays valid (and may be moved from) until the next call.
+    vector<uint8_t>& encode(const uint8_t* data, size_t size, bool huffman_only, int level,
+        int window = DEFAULT_WINDOW, BlockStats* stats = nullptr, BlockTimes* times = nullptr,
+        const Dictionary* dict = nullptr);
+
+    // Code data[0, size) as one or more blocks, cut where split_block picks.
+    // LZ77 matches cannot reach across a cut, so a chunk that splits is
+    // parsed once whole and its tokens are cut at the blocks (cut_tokens);
+    // the cuts are kept only if the blocks are estimated to come out smaller
+    // than the chunk coded whole, and only the blocks that lost many matches
+    // to them are parsed again.  Sets `sizes` to the raw block sizes; the
+    // payloads stay valid (and may be moved from) until the next call.
+    vector<vector<uint8_t>>& encode_chunk(const uint8_t* data, size_t size, vector<size_t>& sizes,
+        bool huffman_only, int level, int window = DEFAULT_WINDOW, BlockStats* stats = nullptr,
+        BlockTimes* times = nullptr, const Dictionary* dict = nullptr);
+
+private:
+    // A way to code a block: LZ77 or Huffman-only, with the dictionary's
+    // tables or its own, and with its own either Huffman (lit, dist) or
+    // tANS (fse_lit, fse_dist or fse_bytes) coded.  `bits` is the payload
+    // size, exact or (tANS) estimated.
+    struct Choice {
+        bool lz, shared, fse;
+        const CodeTable *lit, *dist;
+        uint64_t bits;
+    };
+
+    // LZ77 parse of data[0, size), whose matches may reach into the
+    // dictionary content.  Valid until the next parse.
+    const vector<LZToken>& parse(const uint8_t* data, size_t size, int level, int window, const Dictionary* dict);
+
+    // Cut the tokens of a chunk into block_tokens, one list per block of
+    // `sizes`.  The part of a match inside a block stays a match if it is at
+    // least MIN_MATCH long and copies from inside the block or from the
+    // dictionary (its distance then shrinks by the block's offset).  Past the
+    // first block a match copying from the dictionary is kept only up to the
+    // dictionary's end.  The rest of it becomes literals.
+    void cut_tokens(const uint8_t* data, const vector<LZToken>& tokens, const vector<size_t>& sizes);
+
+    // Code one block from its LZ77 tokens (ignored unless lz), the cheapest
+    // way; see encode.
+    vector<uint8_t>& encode_tokens(const uint8_t* data, size_t size, bool lz, const vector<LZToken>& tokens,
+        BlockStats* stats, BlockTimes* times, const Dictionary* dict);
+
+    // Write the payload of a coded block to `encoded`.
+    void write_payload(const Choice& c, const uint8_t* data, size_t size, const vector<LZToken>& tokens,
+        bool streams, const Dictionary* dict);
+
+    // Sampling estimate of whether LZ77 would find matches in data[0, size),
+    // run before the parse.  The 6-byte strings at about one position in
+    // 2^PROBE_SAMPLE_BITS are looked up among the earlier samples (those of
+    // the dictionary content first); the positions are picked by the hash of
+    // the string, so a repeat is sampled in every copy.  Each hit stands for
+    // about 2^PROBE_SAMPLE_BITS matched bytes, which undercounts the short
+    // matches.  True if the matches would cover less than 1/256 of the block:
+    // random data finds next to none, while already compressed data with
+    // repeats in it (a zip holding some stored files, gzip output of long
+    // repeats) is still worth the parse.  A slot holds the string in its low
+    // 48 bits and the call's generation in the top 16, so slots left by
+    // earlier calls never match and the table is cleared only when the
+    // generation wraps.
+    bool few_matches(const Dictionary* dict, const uint8_t* data, size_t size);
+
+    LZParser parser;
+    BitWriter encoded;
+    vector<uint8_t> stored;   // payload of a stored block
+    vector<uint8_t> joined;   // dictionary content followed by the block
+    vector<vector<uint8_t>> payloads;   // blocks of the last chunk
+    vector<vector<LZToken>> block_tokens;   // encode_chunk: the chunk's tokens, cut at the blocks
+    vector<size_t> cut_bytes;               // and the matched bytes each block lost to the cuts
+    vector<uint64_t> probe;             // few_matches: sampled strings by hash,
+    uint16_t probe_generation = 0;      // tagged with the call they were seen in
+    FseTable fse_bytes, fse_lit, fse_dist;   // tANS tables of the block being coded
+    vector<uint8_t> fse_scratch;        // tANS bits, gathered back to front
+};
+
+// Block decoder state kept between blocks: the decoding tables keep their
+// memory.  One decoder per thread.
+class BlockDecoder {
+public:
+    // Decode one block payload into dst[0, raw_size).  Returns false if the
+    // payload is corrupt.
+    bool decode(const uint8_t* payload, size_t payload_size, size_t raw_size, uint8_t* dst,
+        BlockTimes* times = nullptr, const Dictionary* dict = nullptr);
+
+private:
+    uint8_t lengths[MAX_ALPHABET];
+    uint16_t norm[MAX_ALPHABET];
+    HuffDecoder decoder, dist_decoder;
+    FseDecoder fse_decoder, fse_dist_decoder;
+};
+
+// One-shot forms of BlockEncoder::encode and BlockDecoder::decode.
+vector<uint8_t> compress_block(const uint8_t* data, size_t size, bool huffman_only, int level,
+    int window = DEFAULT_WINDOW, BlockStats* stats = nullptr, BlockTimes* times = nullptr);
+bool decompress_block(const uint8_t* payload, size_t payload_size, size_t raw_size, string& out,
+    BlockTimes* times = nullptr);
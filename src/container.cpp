@@ -0,0 +1,393 @@
+#include <bits/stdc++.h>
+#include "container.h"
+#include "crc32.h"
+#include "threadpool.h"
+
+using namespace std;
+
+// Each thread keeps one block coder, so the workers reuse their match finder,
+// tables and buffers from block to block.
+static BlockEncoder& thread_encoder() {
+    thread_local BlockEncoder encoder;
+    return encoder;
+}
+
+static BlockDecoder& thread_decoder() {
+    thread_local BlockDecoder decoder;
+    return decoder;
+}
+
+// The dictionary with the given id, or nullptr.
+static const Dictionary* find_dictionary(const vector<Dictionary>& dicts, uint32_t id) {
+    for (const Dictionary& d : dicts)
+        if (d.id == id) return &d;
+    return nullptr;
+}
+
+// Reads the header and picks the stream's dictionary, if it has one, from
+// `dicts`.
+static bool read_header(InputFile& in, uint8_t& flag, const vector<Dictionary>& dicts, const Dictionary*& dict) {
+    uint32_t sig = 0;
+    uint8_t version = 0;
+    uint16_t reserved = 0;
+    if (!get(in, sig) || sig != SIGNATURE) {
+        fprintf(stderr, "Invalid file signature\n");
+        return false;
+    }
+    get(in, flag);
+    get(in, version);
+    get(in, reserved);
+    if (version != FORMAT_VERSION) {
+        fprintf(stderr, "Unsupported format version %d\n", version);
+        return false;
+    }
+    dict = nullptr;
+    if (flag & FLAG_DICTIONARY) {
+        uint32_t id = 0;
+        if (!get(in, id)) {
+            fprintf(stderr, "Truncated input\n");
+            return false;
+        }
+        if (!(dict = find_dictionary(dicts, id))) {
+            fprintf(stderr, "Compressed with dictionary %08x; pass it with --dict\n", id);
+            return false;
+        }
+    }
+    return true;
+}
+
+int compress_stream(InputFile& in, OutputFile& out, const StreamOptions& opt, StreamStats& stats) {
+    struct Block {
+        uint32_t raw_size;
+        uint32_t crc;
+        vector<uint8_t> payload;
+    };
+    // The blocks of one input chunk.
+    struct Compressed {
+        vector<Block> blocks;
+        BlockStats stats;
+        vector<long long> byte_freq;
+    };
+
+    uint64_t offset = put_header(out, opt.huffman_only, opt.dict);
+
+    uint32_t crc = 0;
+    uint64_t total = 0;
+    vector<IndexEntry> index;
+
+    ThreadPool pool(ThreadPool::resolve(opt.jobs));
+    OrderedPipeline<Compressed> pipeline(pool);
+
+    auto write_blocks = [&](Compressed c) {
+        for (const Block& b : c.blocks) {
+            index.push_back({ offset, total, b.crc });
+            offset += put_block(out, b.raw_size, b.crc, b.payload);
+            crc = crc32_combine(crc, b.crc, b.raw_size);
+            total += b.raw_size;
+        }
+        if (opt.collect_stats) {
+            stats.blocks.add(c.stats);
+            for (int i = 0; i < 256; i++) stats.byte_freq[i] += c.byte_freq[i];
+        }
+    };
+
+    for (;;) {
+        Chunk chunk = in.take(opt.block_size);
+        if (chunk.size == 0) break;
+
+        if (pipeline.full()) write_blocks(pipeline.next());
+        pipeline.submit([chunk = move(chunk), opt]() {
+            Compressed c;
+            vector<size_t> sizes;
+            vector<vector<uint8_t>>& payloads = thread_encoder().encode_chunk(chunk.data, chunk.size, sizes,
+                opt.huffman_only, opt.level, opt.window, opt.collect_stats ? &c.stats : nullptr, nullptr, opt.dict);
+            const uint8_t* p = chunk.data;
+            for (size_t i = 0; i < sizes.size(); i++) {
+                c.blocks.push_back({ (uint32_t)sizes[i], crc32(p, sizes[i]), move(payloads[i]) });
+                p += sizes[i];
+            }
+            if (opt.collect_stats) {
+                uint32_t counts[256] = {};
+                histogram(chunk.data, chunk.size, counts);
+                c.byte_freq.assign(counts, counts + 256);
+            }
+            return c;
+        });
+    }
+    while (!pipeline.empty()) write_blocks(pipeline.next());
+    if (in.failed()) {
+        fprintf(stderr, "Cannot read input file\n");
+        return 1;
+    }
+
+    offset += put_footer(out, index, crc, total, offset);
+
+    if (!out.close()) {
+        fprintf(stderr, "Cannot write output file\n");
+        return 1;
+    }
+    stats.raw_size = total;
+    stats.comp_size = offset;
+    return 0;
+}
+
+// A block read from the input, ready to be decoded on a worker.
+struct PendingBlock {
+    uint32_t raw_size;
+    uint32_t crc;
+    Chunk payload;
+};
+
+// Read the block header and payload at the current position.  `end` is set
+// when the end-of-blocks marker is read instead.
+static bool read_block(InputFile& in, PendingBlock& b, bool& end) {
+    uint32_t payload_size;
+    end = false;
+    if (!get(in, b.raw_size) || !get(in, payload_size)) {
+        fprintf(stderr, "Truncated input\n");
+        return false;
+    }
+    if (b.raw_size == 0) {
+        end = true;
+        return true;
+    }
+    if (b.raw_size > MAX_BLOCK_SIZE || payload_size > 2 * MAX_BLOCK_SIZE) {
+        fprintf(stderr, "Corrupt compressed data\n");
+        return false;
+    }
+    if (!get(in, b.crc) || (b.payload = in.take(payload_size)).size != payload_size) {
+        fprintf(stderr, "Truncated input\n");
+        return false;
+    }
+    return true;
+}
+
+struct DecodedBlock {
+    string data;         // empty when the block was stored into the output mapping
+    uint32_t size;
+    uint32_t crc;        // verified CRC-32 of the block
+    const char* error;   // nullptr on success
+};
+
+// Decode and verify one block.  With `dst`, the block is decoded straight
+// into its final place in the output mapping instead of being returned.
+static DecodedBlock decode_block(const PendingBlock& b, const Dictionary* dict, uint8_t* dst = nullptr) {
+    DecodedBlock d{ string(), b.raw_size, b.crc, nullptr };
+    if (!dst) {
+        d.data.resize(b.raw_size);
+        dst = (uint8_t*)&d.data[0];
+    }
+    if (!thread_decoder().decode(b.payload.data, b.payload.size, b.raw_size, dst, nullptr, dict))
+        d.error = "Corrupt compressed data";
+    else if (crc32(dst, b.raw_size) != b.crc)
+        d.error = "CRC mismatch";
+    return d;
+}
+
+// Size of the original data from the trailer of a mapped input, used to
+// pre-size the output.  The trailer must agree with the index and the last
+// block header, so a damaged trailer cannot make us reserve a huge file; the
+// stream is still verified block by block.
+static bool peek_total(const InputFile& in, uint64_t& total) {
+    uint64_t size = in.size();
+    if (!in.mapped() || size < HEADER_SIZE + TRAILER_SIZE) return false;
+    const uint8_t* p = in.data();
+    const uint8_t* trailer = p + size - TRAILER_SIZE;
+    total = load<uint64_t>(trailer + 4);
+    uint64_t index_offset = load<uint64_t>(trailer + 12);
+    uint32_t count = load<uint32_t>(trailer + 20);
+    if (count == 0) return total == 0;
+    if ((uint64_t)count * (8 + 8 + 4) > size - HEADER_SIZE - TRAILER_SIZE - 4) return false;
+    if (index_offset != size - TRAILER_SIZE - 4 - (uint64_t)count * (8 + 8 + 4)) return false;
+    if (load<uint32_t>(p + index_offset) != count) return false;
+    const uint8_t* last = p + index_offset + 4 + (uint64_t)(count - 1) * (8 + 8 + 4);
+    uint64_t comp_offset = load<uint64_t>(last);
+    uint64_t raw_offset = load<uint64_t>(last + 8);
+    if (comp_offset < HEADER_SIZE || comp_offset + 4 > index_offset) return false;
+    return raw_offset + load<uint32_t>(p + comp_offset) == total;
+}
+
+int decompress_stream(InputFile& in, OutputFile& out, int jobs, const vector<Dictionary>& dicts) {
+    uint8_t flag;
+    const Dictionary* dict;
+    if (!read_header(in, flag, dicts, dict)) return 1;
+
+    uint64_t expected = 0;
+    uint8_t* dst = peek_total(in, expected) ? out.map(expected) : nullptr;
+
+    uint32_t crc = 0;
+    uint64_t total = 0;
+    uint32_t blocks = 0;
+    bool failed = false;
+
+    ThreadPool pool(ThreadPool::resolve(jobs));
+    OrderedPipeline<DecodedBlock> pipeline(pool);
+
+    auto write_block = [&](DecodedBlock d) {
+        if (failed) return;
+        if (d.error) {
+            fprintf(stderr, "%s\n", d.error);
+            failed = true;
+            return;
+        }
+        if (!dst) out.write(d.data.data(), d.data.size());
+        crc = crc32_combine(crc, d.crc, d.size);
+        total += d.size;
+    };
+
+    uint64_t submitted = 0;
+
+    for (;;) {
+        PendingBlock b;
+        bool end;
+        if (!read_block(in, b, end)) return 1;
+        if (end) break;
+        blocks++;
+        if (pipeline.full()) write_block(pipeline.next());
+        if (failed) return 1;
+        uint8_t* block_dst = nullptr;
+        if (dst) {
+            if (b.raw_size > expected - submitted) {
+                fprintf(stderr, "Size mismatch\n");
+                return 1;
+            }
+            block_dst = dst + submitted;
+        }
+        submitted += b.raw_size;
+        pipeline.submit([b = move(b), dict, block_dst]() { return decode_block(b, dict, block_dst); });
+    }
+    while (!pipeline.empty()) write_block(pipeline.next());
+    if (failed) return 1;
+
+    // The index is only needed for random access; skip it.
+    uint64_t index_offset = in.position();
+    uint32_t count;
+    if (!get(in, count) || count != blocks || !in.skip((uint64_t)count * (8 + 8 + 4))) {
+        fprintf(stderr, "Corrupt block index\n");
+        return 1;
+    }
+
+    uint32_t crc_stored, count_stored;
+    uint64_t total_stored, index_offset_stored;
+    if (!get(in, crc_stored) || !get(in, total_stored) || !get(in, index_offset_stored) || !get(in, count_stored)) {
+        fprintf(stderr, "Truncated input\n");
+        return 1;
+    }
+    if (total != total_stored) {
+        fprintf(stderr, "Size mismatch\n");
+        return 1;
+    }
+    if (crc != crc_stored) {
+        fprintf(stderr, "CRC mismatch\n");
+        return 1;
+    }
+    if (index_offset_stored != index_offset || count_stored != blocks) {
+        fprintf(stderr, "Corrupt trailer\n");
+        return 1;
+    }
+    uint8_t extra;
+    if (in.read(&extra, 1)) {
+        fprintf(stderr, "Trailing data after the end of the stream\n");
+        return 1;
+    }
+    if (!out.close()) {
+        fprintf(stderr, "Cannot write output file\n");
+        return 1;
+    }
+    return 0;
+}
+
+int extract_range(InputFile& in, OutputFile& out, uint64_t start, uint64_t length, int jobs,
+    const vector<Dictionary>& dicts) {
+    uint8_t flag;
+    const Dictionary* dict;
+    if (!read_header(in, flag, dicts, dict)) return 1;
+
+    uint64_t file_size = in.size();
+    if (!in.mapped() || file_size < HEADER_SIZE + TRAILER_SIZE) {
+        fprintf(stderr, "Random access needs a seekable, complete input file\n");
+        return 1;
+    }
+    in.seek(file_size - TRAILER_SIZE);
+    uint32_t crc_stored, count;
+    uint64_t total, index_offset;
+    get(in, crc_stored);
+    get(in, total);
+    get(in, index_offset);
+    get(in, count);
+
+    bool ok = (uint64_t)count * (8 + 8 + 4) <= file_size && in.seek(index_offset);
+    vector<IndexEntry> index(ok ? count : 0);
+    uint32_t index_count = 0;
+    ok = ok && get(in, index_count);
+    for (IndexEntry& e : index) {
+        ok = ok && get(in, e.comp_offset);
+        ok = ok && get(in, e.raw_offset);
+        ok = ok && get(in, e.crc);
+    }
+    if (!ok || index_count != count) {
+        fprintf(stderr, "Corrupt block index\n");
+        return 1;
+    }
+
+    if (start >= total) return 0;
+    uint64_t end = start + min(length, total - start);
+
+    ThreadPool pool(ThreadPool::resolve(jobs));
+    OrderedPipeline<DecodedBlock> pipeline(pool);
+    bool failed = false;
+    uint64_t written = 0;
+
+    // Blocks come back in order, so the slice of each one continues where
+    // the previous one stopped.
+    auto write_block = [&](DecodedBlock d, uint64_t block_start) {
+        if (failed) return;
+        if (d.error) {
+            fprintf(stderr, "%s\n", d.error);
+            failed = true;
+            return;
+        }
+        uint64_t from = max(start, block_start) - block_start;
+        uint64_t to = min(end, block_start + d.data.size()) - block_start;
+        out.write(d.data.data() + from, to - from);
+        written += to - from;
+    };
+
+    deque<uint64_t> starts;
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t block_start = index[i].raw_offset;
+        uint64_t block_end = i + 1 < count ? index[i + 1].raw_offset : total;
+        if (block_end <= start) continue;
+        if (block_start >= end) break;
+
+        PendingBlock b;
+        bool last;
+        if (!in.seek(index[i].comp_offset)) {
+            fprintf(stderr, "Corrupt block index\n");
+            return 1;
+        }
+        if (!read_block(in, b, last)) return 1;
+        if (last || b.crc != index[i].crc || block_start + b.raw_size != block_end) {
+            fprintf(stderr, "Corrupt block index\n");
+            return 1;
+        }
+        if (pipeline.full()) {
+            write_block(pipeline.next(), starts.front());
+            starts.pop_front();
+        }
+        if (failed) return 1;
+        starts.push_back(block_start);
+        pipeline.submit([b = move(b), dict]() { return decode_block(b, dict); });
+    }
+    while (!pipeline.empty()) {
+        write_block(pipeline.next(), starts.front());
+        starts.pop_front();
+    }
+    if (failed) return 1;
+
+    if (!out.close() || written != end - start) {
+        fprintf(stderr, "Cannot write output file\n");
+        return 1;
+    }
+    return 0;
+}
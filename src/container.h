@@ -0,0 +1,129 @@
+/*
+The huffzip container: header, blocks, block index and trailer.
+
+compress_stream: reads the input in chunks, compresses them on a worker pool
+                 and writes them in order, followed by the index and trailer.
+                 A worker cuts its chunk into blocks where the statistics
+                 shift (BlockEncoder::encode_chunk) and codes each one
+                 stored, Huffman-only or LZ77 + Huffman, whichever is
+                 smallest.
+                 Blocks are checksummed on the workers; the file CRC is
+                 combined from the block CRCs.  A mapped input is handed to
+                 the workers in place.
+decompress_stream: decodes blocks in parallel and writes them in order; works
+                 on pipes, the index is skipped.  When the input is mapped and
+                 the output is a regular file, the output is pre-sized from
+                 the trailer and mapped, and each worker stores its block at
+                 its final offset.
+extract_range: uses the index to decode only the blocks that overlap a byte
+                 range of the original data (mapped input only).
+
+Layout (all fields little-endian):
+  header   signature u32, flag u8 (bit 0: LZ77 was enabled, informational,
+           as each block names its own coding; bit 1: a dictionary id
+           follows), version u8, reserved u16,
+           [dictionary id u32]
+  blocks   raw size u32, payload size u32, CRC-32 of the raw block u32, payload
+           (stored when the payload size equals the raw size; block.cpp)
+  end      raw size 0, payload size 0
+  index    block count u32, then per block:
+           file offset of the block u64, offset in the original data u64, CRC-32 u32
+  trailer  CRC-32 of the original data u32, original size u64,
+           file offset of the index u64, block count u32
+The trailer has a fixed size, so a reader with a seekable input finds the
+index from the end of the file.
+*/
+
+#pragma once
+#include <bits/stdc++.h>
+#include "block.h"
+#include "fileio.h"
+
+using namespace std;
+
+const uint32_t SIGNATURE      = 0x1518C234;
+const uint8_t  FORMAT_VERSION = 9;  // 0: raw frequency table, 1: canonical code lengths, 2: blocks, 3: block index,
+                                    // 4: distance codes, 5: long lengths and distances, 6: dictionaries,
+                                    // 7: per-block coding, 8: four-stream Huffman, 9: tANS
+const size_t   HEADER_SIZE    = 4 + 1 + 1 + 2;   // without the dictionary id
+const uint8_t  FLAG_LZ77       = 1;
+const uint8_t  FLAG_DICTIONARY = 2;
+const size_t   TRAILER_SIZE   = 4 + 8 + 8 + 4;
+
+// Fixed-width little-endian fields of the container.  The writers take any
+// sink with write(p, n), so the library API (api.cpp) frames memory buffers
+// with the same code.
+template <class Sink, class T> static void put(Sink& out, T v) { out.write(&v, sizeof v); }
+template <class T> static bool get(InputFile& in, T& v) { return in.read(&v, sizeof v); }
+template <class T> static T load(const uint8_t* p) { T v; memcpy(&v, p, sizeof v); return v; }
+
+struct StreamOptions {
+    bool huffman_only = false;
+    int level = DEFAULT_LEVEL;
+    int window = DEFAULT_WINDOW;  // LZ77 window, limited in practice by the block size
+    size_t block_size = DEFAULT_BLOCK_SIZE;   // largest block; split_block may cut smaller ones
+    int jobs = 1;
+    bool collect_stats = false;   // fill BlockStats and byte_freq for -v
+    const Dictionary* dict = nullptr;
+};
+
+struct StreamStats {
+    uint64_t raw_size = 0;
+    uint64_t comp_size = 0;
+    BlockStats blocks;
+    vector<long long> byte_freq = vector<long long>(256, 0);
+};
+
+struct IndexEntry {
+    uint64_t comp_offset;   // file offset of the block header
+    uint64_t raw_offset;    // offset of the block in the original data
+    uint32_t crc;
+};
+
+// Returns the bytes written.
+template <class Sink> static uint64_t put_header(Sink& out, bool huffman_only, const Dictionary* dict) {
+    put(out, SIGNATURE);
+    put(out, (uint8_t)((huffman_only ? 0 : FLAG_LZ77) | (dict ? FLAG_DICTIONARY : 0)));
+    put(out, FORMAT_VERSION);
+    put(out, (uint16_t)0);
+    if (dict) put(out, dict->id);
+    return HEADER_SIZE + (dict ? 4 : 0);
+}
+
+// Block header and payload; returns the bytes written.
+template <class Sink>
+static uint64_t put_block(Sink& out, uint32_t raw_size, uint32_t crc, const vector<uint8_t>& payload) {
+    put(out, raw_size);
+    put(out, (uint32_t)payload.size());
+    put(out, crc);
+    out.write(payload.data(), payload.size());
+    return BLOCK_HEADER_SIZE + payload.size();
+}
+
+// End marker, index and trailer, for blocks written from `offset` on; returns
+// the bytes written.
+template <class Sink>
+static uint64_t put_footer(Sink& out, const vector<IndexEntry>& index, uint32_t crc, uint64_t total, uint64_t offset) {
+    put(out, (uint32_t)0);
+    put(out, (uint32_t)0);
+    uint64_t index_offset = offset + 4 + 4;
+    put(out, (uint32_t)index.size());
+    for (const IndexEntry& e : index) {
+        put(out, e.comp_offset);
+        put(out, e.raw_offset);
+        put(out, e.crc);
+    }
+    put(out, crc);
+    put(out, total);
+    put(out, index_offset);
+    put(out, (uint32_t)index.size());
+    return 4 + 4 + 4 + index.size() * (8 + 8 + 4) + TRAILER_SIZE;
+}
+
+int compress_stream(InputFile& in, OutputFile& out, const StreamOptions& opt, StreamStats& stats);
+int decompress_stream(InputFile& in, OutputFile& out, int jobs, const vector<Dictionary>& dicts = {});
+
+// Write bytes [start, start + length) of the original data to `out`,
+// decoding only the blocks that overlap the range.  `in` must be mapped.
+int extract_range(InputFile& in, OutputFile& out, uint64_t start, uint64_t length, int jobs,
+    const vector<Dictionary>& dicts = {});
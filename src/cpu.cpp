@@ -0,0 +1,43 @@
+#include <bits/stdc++.h>
+#include "cpu.h"
+#ifdef HUFFZIP_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+using namespace std;
+
+static CpuFeatures _detect_cpu_features() {
+    CpuFeatures f;
+#ifdef HUFFZIP_X86
+    unsigned regs[4] = { 0, 0, 0, 0 };  // eax, ebx, ecx, edx
+    unsigned ext[4] = { 0, 0, 0, 0 };   // leaf 7
+    uint64_t xcr0 = 0;
+#ifdef _MSC_VER
+    __cpuid((int*)regs, 1);
+    __cpuidex((int*)ext, 7, 0);
+    if ((regs[2] >> 27) & 1) xcr0 = _xgetbv(0);
+#else
+    __get_cpuid(1, &regs[0], &regs[1], &regs[2], &regs[3]);
+    __get_cpuid_count(7, 0, &ext[0], &ext[1], &ext[2], &ext[3]);
+    if ((regs[2] >> 27) & 1) {   // OSXSAVE
+        unsigned lo, hi;
+        __asm__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        xcr0 = ((uint64_t)hi << 32) | lo;
+    }
+#endif
+    f.sse2 = (regs[3] >> 26) & 1;
+    f.pclmul = (regs[2] >> 1) & 1;
+    f.sse41 = (regs[2] >> 19) & 1;
+    f.avx2 = ((ext[1] >> 5) & 1) && (xcr0 & 6) == 6;
+#endif
+    return f;
+}
+
+const CpuFeatures& cpu_features() {
+    static const CpuFeatures features = _detect_cpu_features();
+    return features;
+}
@@ -0,0 +1,24 @@
+/*
+Runtime CPU feature detection for the accelerated kernels.
+
+cpu_features() queries CPUID once and caches the result.  Kernels compiled
+for a newer instruction set (with a per-function target attribute) are only
+called when the matching flag is set, so a single binary runs everywhere.
+*/
+
+#pragma once
+#include <bits/stdc++.h>
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define HUFFZIP_X86 1
+#endif
+
+using namespace std;
+
+struct CpuFeatures {
+    bool sse2 = false;
+    bool sse41 = false;
+    bool pclmul = false;
+    bool avx2 = false;    // also requires the OS to save the YMM registers
+};
+
+const CpuFeatures& cpu_features();
@@ -0,0 +1,186 @@
+#include <bits/stdc++.h>
+#include "crc32.h"
+#include "cpu.h"
+#if defined(HUFFZIP_X86) && (defined(__GNUC__) || defined(_MSC_VER))
+#define HUFFZIP_CRC_CLMUL 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+const uint32_t CRC_POLY = 0xEDB88320;
+
+struct CrcTables {
+    uint32_t t[8][256];
+};
+
+static constexpr CrcTables _make_crc_tables() {
+    CrcTables tables{};
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = c & 1 ? (c >> 1) ^ CRC_POLY : c >> 1;
+        tables.t[0][i] = c;
+    }
+    for (int s = 1; s < 8; s++)
+        for (int i = 0; i < 256; i++)
+            tables.t[s][i] = (tables.t[s - 1][i] >> 8) ^ tables.t[0][tables.t[s - 1][i] & 0xFF];
+    return tables;
+}
+
+static constexpr CrcTables CRC_TABLES = _make_crc_tables();
+
+// `crc` is the raw (pre-inverted) register in both engines.
+static uint32_t _crc32_slice8(const uint8_t* p, size_t size, uint32_t crc) {
+    const auto& t = CRC_TABLES.t;
+    while (size >= 8) {
+        uint32_t lo, hi;
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + 4, 4);
+        lo ^= crc;
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24]
+            ^ t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+        p += 8;
+        size -= 8;
+    }
+    while (size-- > 0) crc = t[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+#ifdef HUFFZIP_CRC_CLMUL
+// Folding constants x^k mod P for the reflected polynomial.
+alignas(16) static const uint64_t CRC_K1K2[2] = { 0x0154442bd4, 0x01c6e41596 };  // fold by 4 x 128 bits
+alignas(16) static const uint64_t CRC_K3K4[2] = { 0x01751997d0, 0x00ccaa009e };  // fold by 128 bits
+alignas(16) static const uint64_t CRC_K5K0[2] = { 0x0163cd6124, 0x0000000000 };  // 64 -> 32 bits
+alignas(16) static const uint64_t CRC_POLY_MU[2] = { 0x01db710641, 0x01f7011641 };  // P(x), Barrett mu
+
+// Requires size >= 64 and a multiple of 16.
+#ifdef __GNUC__
+__attribute__((target("pclmul,sse4.1")))
+#endif
+static uint32_t _crc32_clmul(const uint8_t* p, size_t size, uint32_t crc) {
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    x1 = _mm_loadu_si128((const __m128i*)(p + 0x00));
+    x2 = _mm_loadu_si128((const __m128i*)(p + 0x10));
+    x3 = _mm_loadu_si128((const __m128i*)(p + 0x20));
+    x4 = _mm_loadu_si128((const __m128i*)(p + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+    x0 = _mm_load_si128((const __m128i*)CRC_K1K2);
+    p += 64;
+    size -= 64;
+
+    // Fold four lanes in parallel.
+    while (size >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        y5 = _mm_loadu_si128((const __m128i*)(p + 0x00));
+        y6 = _mm_loadu_si128((const __m128i*)(p + 0x10));
+        y7 = _mm_loadu_si128((const __m128i*)(p + 0x20));
+        y8 = _mm_loadu_si128((const __m128i*)(p + 0x30));
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+        p += 64;
+        size -= 64;
+    }
+
+    // Fold the four lanes into one.
+    x0 = _mm_load_si128((const __m128i*)CRC_K3K4);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    // Remaining 16-byte blocks.
+    while (size >= 16) {
+        x2 = _mm_loadu_si128((const __m128i*)p);
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        p += 16;
+        size -= 16;
+    }
+
+    // 128 -> 64 bits.
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+    x0 = _mm_loadl_epi64((const __m128i*)CRC_K5K0);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction to 32 bits.
+    x0 = _mm_load_si128((const __m128i*)CRC_POLY_MU);
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+#endif
+
+uint32_t crc32(const void* data, size_t size, uint32_t crc) {
+    const uint8_t* p = (const uint8_t*)data;
+    crc = ~crc;
+#ifdef HUFFZIP_CRC_CLMUL
+    static const bool use_clmul = cpu_features().pclmul && cpu_features().sse41;
+    if (use_clmul && size >= 64) {
+        size_t n = size & ~(size_t)15;
+        crc = _crc32_clmul(p, n, crc);
+        p += n;
+        size -= n;
+    }
+#endif
+    return ~_crc32_slice8(p, size, crc);
+}
+
+// a(x) * b(x) mod P(x), bit-reflected.
+static uint32_t _crc_multmodp(uint32_t a, uint32_t b) {
+    uint32_t m = 1u << 31, p = 0;
+    for (;;) {
+        if (a & m) {
+            p ^= b;
+            if ((a & (m - 1)) == 0) break;
+        }
+        m >>= 1;
+        b = b & 1 ? (b >> 1) ^ CRC_POLY : b >> 1;
+    }
+    return p;
+}
+
+// x^(n * 2^k) mod P(x).
+static uint32_t _crc_x2nmodp(uint64_t n, unsigned k) {
+    static const auto table = [] {
+        array<uint32_t, 32> t{};
+        t[0] = 1u << 30;   // x^1
+        for (int i = 1; i < 32; i++) t[i] = _crc_multmodp(t[i - 1], t[i - 1]);
+        return t;
+    }();
+    uint32_t p = 1u << 31;   // x^0
+    while (n) {
+        if (n & 1) p = _crc_multmodp(table[k & 31], p);
+        n >>= 1;
+        k++;
+    }
+    return p;
+}
+
+uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, uint64_t len2) {
+    return _crc_multmodp(_crc_x2nmodp(len2, 3), crc1) ^ crc2;
+}
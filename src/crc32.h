@@ -0,0 +1,24 @@
+/*
+CRC-32 (reflected polynomial 0xEDB88320, as in zlib / gzip / PNG).
+
+crc32(data, size, crc): continues `crc` (0 to start) over `size` bytes.
+crc32_combine(crc1, crc2, len2): CRC of the concatenation A + B from the CRCs
+    of A and B and the length of B, without touching the data.  Lets blocks be
+    checksummed independently on worker threads.
+
+Two engines:
+  Slicing-by-8 (portable): eight 256-entry tables let the loop consume eight
+    bytes per iteration with independent table lookups.
+  Carry-less multiply folding (x86 with PCLMULQDQ, picked at runtime): folds
+    four 128-bit lanes 64 bytes at a time, then reduces to 32 bits with a
+    Barrett reduction (Intel, "Fast CRC Computation for Generic Polynomials
+    Using PCLMULQDQ Instruction").
+*/
+
+#pragma once
+#include <bits/stdc++.h>
+
+using namespace std;
+
+uint32_t crc32(const void* data, size_t size, uint32_t crc = 0);
+uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, uint64_t len2);
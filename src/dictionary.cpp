@@ -0,0 +1,172 @@
+#include <bits/stdc++.h>
+#include "dictionary.h"
+#include "crc32.h"
+
+using namespace std;
+
+bool Dictionary::set_tables(const uint8_t* byte_len, const uint8_t* lit_len, const uint8_t* dist_len) {
+    for (int s = 0; s < 256; s++) if (byte_len[s] == 0 || byte_len[s] > MAX_CODE_LEN) return false;
+    for (int s = 0; s < NUM_SYMBOLS; s++) if (lit_len[s] == 0 || lit_len[s] > MAX_CODE_LEN) return false;
+    for (int s = 0; s < NUM_DIST_SYMBOLS; s++) if (dist_len[s] == 0 || dist_len[s] > MAX_CODE_LEN) return false;
+    memcpy(bytes.len, byte_len, 256);
+    memcpy(lit.len, lit_len, NUM_SYMBOLS);
+    memcpy(dist.len, dist_len, NUM_DIST_SYMBOLS);
+    canonical_codes(bytes.len, 256, bytes.code);
+    canonical_codes(lit.len, NUM_SYMBOLS, lit.code);
+    canonical_codes(dist.len, NUM_DIST_SYMBOLS, dist.code);
+    return byte_decoder.build(bytes.len, 256) && lit_decoder.build(lit.len, NUM_SYMBOLS)
+        && dist_decoder.build(dist.len, NUM_DIST_SYMBOLS);
+}
+
+vector<uint8_t> Dictionary::serialize() const {
+    vector<uint8_t> out;
+    auto put32 = [&](uint32_t v) { for (int i = 0; i < 4; i++) out.push_back((uint8_t)(v >> (8 * i))); };
+    put32(DICT_SIGNATURE);
+    out.push_back(DICT_VERSION);
+    out.insert(out.end(), 3, 0);
+    put32(id);
+    put32((uint32_t)content.size());
+    out.insert(out.end(), content.begin(), content.end());
+    out.insert(out.end(), bytes.len, bytes.len + 256);
+    out.insert(out.end(), lit.len, lit.len + NUM_SYMBOLS);
+    out.insert(out.end(), dist.len, dist.len + NUM_DIST_SYMBOLS);
+    put32(crc32(out.data(), out.size()));
+    return out;
+}
+
+bool Dictionary::parse(const uint8_t* p, size_t size) {
+    const size_t fixed = 4 + 4 + 4 + 4 + 256 + NUM_SYMBOLS + NUM_DIST_SYMBOLS + 4;
+    auto get32 = [](const uint8_t* q) { return q[0] | q[1] << 8 | q[2] << 16 | (uint32_t)q[3] << 24; };
+    if (size < fixed || get32(p) != DICT_SIGNATURE || p[4] != DICT_VERSION) return false;
+    uint32_t content_size = get32(p + 12);
+    if (content_size > MAX_DICT_SIZE || size != fixed + content_size) return false;
+    if (crc32(p, size - 4) != get32(p + size - 4)) return false;
+    id = get32(p + 8);
+    content.assign(p + 16, p + 16 + content_size);
+    const uint8_t* lengths = p + 16 + content_size;
+    return id != 0 && set_tables(lengths, lengths + 256, lengths + 256 + NUM_SYMBOLS);
+}
+
+// Samples flattened into one buffer; sample i is data[start[i], start[i + 1]).
+struct _SampleSet {
+    vector<uint8_t> data;
+    vector<size_t> start;
+};
+
+// Pick up to `dict_size` bytes of content from the samples.
+static vector<uint8_t> _select_content(const _SampleSet& set, size_t dict_size) {
+    const int GRAM = 6, SEGMENT = 64, STRIDE = 16, HASH_BITS = 20;
+    size_t samples = set.start.size() - 1;
+    auto gram_hash = [&](size_t p) {
+        uint64_t v = 0;
+        memcpy(&v, &set.data[p], GRAM);
+        return (uint32_t)((v * 0x9E3779B97F4A7C15ull) >> (64 - HASH_BITS));
+    };
+
+    // score[h]: samples the gram occurs in, less one (a gram seen in one
+    // sample only says nothing about the others).
+    vector<uint32_t> score((size_t)1 << HASH_BITS, 0), seen_in((size_t)1 << HASH_BITS, UINT32_MAX);
+    for (size_t i = 0; i < samples; i++) {
+        for (size_t p = set.start[i]; p + GRAM <= set.start[i + 1]; p++) {
+            uint32_t h = gram_hash(p);
+            if (seen_in[h] != i) {
+                if (seen_in[h] != UINT32_MAX) score[h]++;
+                seen_in[h] = (uint32_t)i;
+            }
+        }
+    }
+
+    // Lazy greedy: a segment's score only drops as grams are taken, so the
+    // top of the queue is the best pick once its score is current.
+    struct Candidate {
+        uint64_t score;
+        size_t pos, end;
+        bool operator<(const Candidate& o) const { return score < o.score || (score == o.score && pos > o.pos); }
+    };
+    auto segment_score = [&](size_t pos, size_t end) {
+        uint64_t s = 0;
+        for (size_t p = pos; p + GRAM <= end; p++) s += score[gram_hash(p)];
+        return s;
+    };
+    priority_queue<Candidate> queue;
+    for (size_t i = 0; i < samples; i++) {
+        size_t end = set.start[i + 1];
+        for (size_t p = set.start[i]; p + GRAM <= end; p += STRIDE) {
+            size_t seg_end = min(p + SEGMENT, end);
+            uint64_t s = segment_score(p, seg_end);
+            if (s > 0) queue.push({ s, p, seg_end });
+        }
+    }
+
+    vector<pair<size_t, size_t>> picked;
+    size_t total = 0;
+    while (total < dict_size && !queue.empty()) {
+        Candidate c = queue.top();
+        queue.pop();
+        uint64_t s = segment_score(c.pos, c.end);
+        if (s == 0) continue;
+        if (s < c.score) {
+            queue.push({ s, c.pos, c.end });
+            continue;
+        }
+        picked.push_back({ c.pos, c.end });
+        total += c.end - c.pos;
+        for (size_t p = c.pos; p + GRAM <= c.end; p++) score[gram_hash(p)] = 0;
+    }
+
+    // Best segment last; anything over the size is cut from the front.
+    vector<uint8_t> content;
+    for (size_t k = picked.size(); k-- > 0;)
+        content.insert(content.end(), set.data.begin() + picked[k].first, set.data.begin() + picked[k].second);
+    if (content.size() > dict_size) content.erase(content.begin(), content.end() - dict_size);
+    return content;
+}
+
+// Train a dictionary of at most `dict_size` bytes of content on `samples`,
+// with the tables fitted to LZ77 parses at `level`.  `id` 0 derives the id
+// from the dictionary itself.
+Dictionary train_dictionary(const vector<vector<uint8_t>>& samples, size_t dict_size, int level,
+    uint32_t id) {
+    _SampleSet set;
+    set.start.push_back(0);
+    for (auto& s : samples) {
+        set.data.insert(set.data.end(), s.begin(), s.end());
+        set.start.push_back(set.data.size());
+    }
+    Dictionary dict;
+    dict.content = _select_content(set, min(dict_size, MAX_DICT_SIZE));
+
+    // Every symbol starts at one so the codes cover any input.
+    uint32_t byte_freq[256], freq[NUM_SYMBOLS], dist_freq[NUM_DIST_SYMBOLS];
+    fill(byte_freq, byte_freq + 256, 1);
+    fill(freq, freq + NUM_SYMBOLS, 1);
+    fill(dist_freq, dist_freq + NUM_DIST_SYMBOLS, 1);
+    LZParser parser;
+    vector<uint8_t> joined;
+    for (auto& s : samples) {
+        histogram(s.data(), s.size(), byte_freq);
+        joined.assign(dict.content.begin(), dict.content.end());
+        joined.insert(joined.end(), s.begin(), s.end());
+        for (const LZToken& t : parser.parse(joined.data(), joined.size(), level, DEFAULT_WINDOW, MAX_MATCH,
+                 dict.content.size())) {
+            if (t.is_literal) freq[(unsigned char)t.literal]++;
+            else {
+                freq[256 + length_code(t.length)]++;
+                dist_freq[dist_code(t.distance)]++;
+            }
+        }
+    }
+    uint8_t byte_len[256], lit_len[NUM_SYMBOLS], dist_len[NUM_DIST_SYMBOLS];
+    huffman_code_lengths(byte_freq, 256, MAX_CODE_LEN, byte_len);
+    huffman_code_lengths(freq, NUM_SYMBOLS, MAX_CODE_LEN, lit_len);
+    huffman_code_lengths(dist_freq, NUM_DIST_SYMBOLS, MAX_CODE_LEN, dist_len);
+    dict.set_tables(byte_len, lit_len, dist_len);
+
+    if (id == 0) {
+        vector<uint8_t> body = dict.serialize();
+        id = crc32(body.data(), body.size() - 4);   // without its own CRC, which would cancel out
+        if (id == 0) id = 1;
+    }
+    dict.id = id;
+    return dict;
+}
@@ -0,0 +1,58 @@
+/*
+Dictionaries for small inputs.
+
+A dictionary holds content that every block is compressed as if it followed,
+so even the first bytes of a block find matches, and Huffman tables trained
+on typical data.  In a stream compressed with a dictionary every coded
+block has a second bit after its type: 1 means the block is coded with the
+dictionary's tables and carries no code length header, 0 means it carries
+its own tables as usual.  The encoder picks whichever is smaller, so large
+blocks lose nothing.
+
+train_dictionary: builds a dictionary from a set of samples.  The content is
+                  chosen like a (much simplified) COVER: every 6-byte gram is
+                  scored by the number of samples it occurs in, and 64-byte
+                  segments are picked greedily by the score of the grams they
+                  still add.  The best segments go at the end, nearest to the
+                  data, where distances are cheapest.  The tables are trained
+                  by compressing every sample against that content; every
+                  symbol keeps a code, so they can code any input.
+
+Dictionary file layout (little-endian):
+  signature u32, version u8, reserved u8 x3, id u32, content size u32,
+  content, code lengths: 256 bytes (Huffman-only), NUM_SYMBOLS (literals and
+  lengths), NUM_DIST_SYMBOLS (distances), CRC-32 of everything before u32
+Compressed streams refer to the dictionary by its id.
+*/
+
+#pragma once
+#include <bits/stdc++.h>
+#include "lzparse.h"
+
+using namespace std;
+
+const uint32_t DICT_SIGNATURE    = 0x1518D1C7;
+const uint8_t  DICT_VERSION      = 1;
+const size_t   DEFAULT_DICT_SIZE = 32 << 10;
+const size_t   MAX_DICT_SIZE     = 1 << 20;
+
+struct Dictionary {
+    uint32_t id = 0;
+    vector<uint8_t> content;
+    CodeTable bytes{}, lit{}, dist{};   // shared codes for Huffman-only and LZ77 blocks
+    HuffDecoder byte_decoder, lit_decoder, dist_decoder;
+
+    // Set the shared codes from their lengths.  Every symbol must have a code.
+    bool set_tables(const uint8_t* byte_len, const uint8_t* lit_len, const uint8_t* dist_len);
+
+    vector<uint8_t> serialize() const;
+
+    // Load a serialized dictionary; returns false if it is not a valid one.
+    bool parse(const uint8_t* p, size_t size);
+};
+
+// Train a dictionary of at most `dict_size` bytes of content on `samples`,
+// with the tables fitted to LZ77 parses at `level`.  `id` 0 derives the id
+// from the dictionary itself.
+Dictionary train_dictionary(const vector<vector<uint8_t>>& samples, size_t dict_size, int level = DEFAULT_LEVEL,
+    uint32_t id = 0);
@@ -0,0 +1,242 @@
+#include <bits/stdc++.h>
+#include "fileio.h"
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+#ifdef _WIN32
+static int _sys_open_read(const string& name) { return _open(name.c_str(), _O_RDONLY | _O_BINARY); }
+static int _sys_open_write(const string& name) {
+    return _open(name.c_str(), _O_RDWR | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+}
+static long long _sys_read(int fd, void* p, size_t n) { return _read(fd, p, (unsigned)min(n, (size_t)1 << 30)); }
+static long long _sys_write(int fd, const void* p, size_t n) {
+    return _write(fd, p, (unsigned)min(n, (size_t)1 << 30));
+}
+static void _sys_close(int fd) { _close(fd); }
+static void _sys_binary(int fd) { _setmode(fd, _O_BINARY); }
+#else
+static int _sys_open_read(const string& name) { return ::open(name.c_str(), O_RDONLY); }
+static int _sys_open_write(const string& name) { return ::open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644); }
+static long long _sys_read(int fd, void* p, size_t n) { return ::read(fd, p, n); }
+static long long _sys_write(int fd, const void* p, size_t n) { return ::write(fd, p, n); }
+static void _sys_close(int fd) { ::close(fd); }
+static void _sys_binary(int) {}
+#endif
+
+
+bool InputFile::open(const string& name) {
+    if (name == "-") {
+        fd = 0;
+        _sys_binary(fd);
+        return true;
+    }
+    fd = _sys_open_read(name);
+    if (fd < 0) return false;
+    owns_fd = true;
+    try_map();
+    return true;
+}
+
+bool InputFile::read(void* dst, size_t n) {
+    Chunk c = take(n);
+    if (c.size != n) return false;
+    memcpy(dst, c.data, n);
+    return true;
+}
+
+Chunk InputFile::take(size_t n) {
+    Chunk c;
+    if (is_mapped) {
+        c.size = (size_t)min<uint64_t>(n, map_size - pos);
+        c.data = map + pos;
+        pos += c.size;
+        return c;
+    }
+    c.owner = make_shared<vector<uint8_t>>(n);
+    uint8_t* dst = c.owner->data();
+    size_t got = min(n, buf_end - buf_pos);
+    memcpy(dst, buf->data + buf_pos, got);
+    buf_pos += got;
+    while (got < n) {
+        if (n - got >= IO_BUFFER_SIZE) {
+            // Large reads bypass the buffer.
+            long long r = read_some(dst + got, n - got);
+            if (r <= 0) break;
+            got += (size_t)r;
+        }
+        else {
+            if (!fill()) break;
+            size_t k = min(n - got, buf_end - buf_pos);
+            memcpy(dst + got, buf->data + buf_pos, k);
+            buf_pos += k;
+            got += k;
+        }
+    }
+    c.owner->resize(got);
+    c.data = c.owner->data();
+    c.size = got;
+    pos += got;
+    return c;
+}
+
+bool InputFile::skip(uint64_t n) {
+    if (is_mapped) {
+        if (n > map_size - pos) return false;
+        pos += n;
+        return true;
+    }
+    while (n > 0) {
+        if (buf_pos == buf_end && !fill()) return false;
+        size_t k = (size_t)min<uint64_t>(n, buf_end - buf_pos);
+        buf_pos += k;
+        pos += k;
+        n -= k;
+    }
+    return true;
+}
+
+    void InputFile::close() {
+        if (is_mapped && map) {
+#ifdef _WIN32
+            UnmapViewOfFile(map);
+            CloseHandle(mapping);
+#else
+            munmap((void*)map, map_size);
+#endif
+        }
+        map = nullptr;
+        is_mapped = false;
+        if (owns_fd) _sys_close(fd);
+        owns_fd = false;
+        fd = -1;
+    }
+
+    void InputFile::try_map() {
+#ifdef _WIN32
+        struct _stat64 st;
+        if (_fstat64(fd, &st) != 0 || !(st.st_mode & _S_IFREG)) return;
+        if (st.st_size == 0) { is_mapped = true; return; }
+        HANDLE file = (HANDLE)_get_osfhandle(fd);
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) return;
+        map = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!map) { CloseHandle(mapping); mapping = nullptr; return; }
+#else
+        struct stat st;
+        if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) return;
+        if (st.st_size == 0) { is_mapped = true; return; }
+        void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) return;
+        madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+        map = (const uint8_t*)p;
+#endif
+        map_size = (uint64_t)st.st_size;
+        is_mapped = true;
+    }
+
+long long InputFile::read_some(void* dst, size_t n) {
+    long long r;
+    do r = _sys_read(fd, dst, n);
+    while (r < 0 && errno == EINTR);
+    if (r < 0) error = true;
+    return r;
+}
+
+bool InputFile::fill() {
+    buf_pos = buf_end = 0;
+    long long r = read_some(buf->data, buf->size);
+    if (r <= 0) return false;
+    buf_end = (size_t)r;
+    return true;
+}
+
+bool OutputFile::open(const string& name) {
+    if (name == "-") {
+        fd = 1;
+        _sys_binary(fd);
+        return true;
+    }
+    fd = _sys_open_write(name);
+    if (fd < 0) return false;
+    owns_fd = true;
+    regular = true;
+    return true;
+}
+
+void OutputFile::write(const void* p, size_t n) {
+    const uint8_t* src = (const uint8_t*)p;
+    if (used + n > buf->size) {
+        flush();
+        if (n >= buf->size) {
+            write_all(src, n);
+            return;
+        }
+    }
+    memcpy(buf->data + used, src, n);
+    used += n;
+}
+
+void OutputFile::flush() {
+    if (used > 0) write_all(buf->data, used);
+    used = 0;
+}
+
+    uint8_t* OutputFile::map(uint64_t size) {
+        if (!regular || size == 0 || used > 0) return nullptr;
+#ifdef _WIN32
+        HANDLE file = (HANDLE)_get_osfhandle(fd);
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, nullptr);
+        if (!mapping) return nullptr;
+        map_ptr = (uint8_t*)MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0);
+        if (!map_ptr) { CloseHandle(mapping); mapping = nullptr; return nullptr; }
+#else
+        // Reserve the blocks first so a full disk fails here, not as SIGBUS.
+        int rc = posix_fallocate(fd, 0, (off_t)size);
+        if (rc != 0 && rc != EINVAL && rc != EOPNOTSUPP) return nullptr;
+        if (ftruncate(fd, (off_t)size) != 0) return nullptr;
+        void* p = mmap(nullptr, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) return nullptr;
+        map_ptr = (uint8_t*)p;
+#endif
+        map_size = size;
+        return map_ptr;
+    }
+
+    bool OutputFile::close() {
+        flush();
+        if (map_ptr) {
+#ifdef _WIN32
+            if (!FlushViewOfFile(map_ptr, 0)) error = true;
+            UnmapViewOfFile(map_ptr);
+            CloseHandle(mapping);
+#else
+            if (munmap(map_ptr, map_size) != 0) error = true;
+#endif
+            map_ptr = nullptr;
+        }
+        if (owns_fd) _sys_close(fd);
+        owns_fd = false;
+        fd = -1;
+        return !error;
+    }
+
+void OutputFile::write_all(const uint8_t* p, size_t n) {
+    while (n > 0 && !error) {
+        long long r = _sys_write(fd, p, n);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) { error = true; return; }
+        p += r;
+        n -= (size_t)r;
+    }
+}
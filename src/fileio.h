@@ -0,0 +1,130 @@
+/*
+File I/O for the container.
+
+InputFile: regular files are memory-mapped, so blocks are handed to the
+           workers as pointers into the mapping without any copy.  Pipes,
+           stdin and files that cannot be mapped fall back to large reads
+           through a 1 MiB buffer.
+OutputFile: writes go through a 1 MiB page-aligned buffer, and writes larger
+           than the buffer go straight to the file.  When the final size is
+           known up front (decompressing to a regular file) the output can
+           instead be pre-sized and mapped, so blocks are stored directly at
+           their final offsets.
+
+"-" names stdin / stdout.
+*/
+
+#pragma once
+#include <bits/stdc++.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+using namespace std;
+
+const size_t IO_BUFFER_SIZE = 1 << 20;
+
+// Page-aligned byte buffer for I/O.
+struct AlignedBuffer {
+    static constexpr size_t ALIGN = 4096;
+    uint8_t* data;
+    size_t size;
+    explicit AlignedBuffer(size_t size)
+        : data((uint8_t*)::operator new(size, align_val_t(ALIGN))), size(size) {}
+    ~AlignedBuffer() { ::operator delete(data, align_val_t(ALIGN)); }
+    AlignedBuffer(const AlignedBuffer&) = delete;
+    AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+};
+
+// Bytes handed from the input to a worker: points into the input mapping,
+// or into `owner` when the input is streamed.
+struct Chunk {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    shared_ptr<vector<uint8_t>> owner;
+};
+
+class InputFile {
+public:
+    InputFile() = default;
+    InputFile(const InputFile&) = delete;
+    InputFile& operator=(const InputFile&) = delete;
+    ~InputFile() { close(); }
+
+    bool open(const string& name);
+
+    // Mapped inputs expose the whole file and support random access.
+    bool mapped() const { return is_mapped; }
+    const uint8_t* data() const { return map; }
+    uint64_t size() const { return map_size; }
+    uint64_t position() const { return pos; }
+    bool failed() const { return error; }
+
+    bool seek(uint64_t p) {
+        if (!is_mapped || p > map_size) return false;
+        pos = p;
+        return true;
+    }
+
+    // Read exactly `n` bytes; false at end of input.
+    bool read(void* dst, size_t n);
+
+    // Up to `n` bytes (fewer only at end of input).  Zero-copy when mapped.
+    Chunk take(size_t n);
+    bool skip(uint64_t n);
+    void close();
+
+private:
+    int fd = -1;
+    bool owns_fd = false;
+    bool is_mapped = false;
+    bool error = false;
+    const uint8_t* map = nullptr;
+    uint64_t map_size = 0;
+    uint64_t pos = 0;
+#ifdef _WIN32
+    HANDLE mapping = nullptr;
+#endif
+    unique_ptr<AlignedBuffer> buf = make_unique<AlignedBuffer>(IO_BUFFER_SIZE);
+    size_t buf_pos = 0, buf_end = 0;
+
+    void try_map();
+    long long read_some(void* dst, size_t n);
+    bool fill();
+};
+
+class OutputFile {
+public:
+    OutputFile() = default;
+    OutputFile(const OutputFile&) = delete;
+    OutputFile& operator=(const OutputFile&) = delete;
+    ~OutputFile() { close(); }
+
+    bool open(const string& name);
+    bool failed() const { return error; }
+    void write(const void* p, size_t n);
+    void flush();
+
+    // Size a regular output file to exactly `size` bytes and map it for
+    // writing.  Returns nullptr when the output cannot be mapped (stdout,
+    // pipes, empty output, or nothing written yet is required).
+    uint8_t* map(uint64_t size);
+
+    // Flush or unmap; returns false if any write failed.
+    bool close();
+
+private:
+    int fd = -1;
+    bool owns_fd = false;
+    bool regular = false;
+    bool error = false;
+    uint8_t* map_ptr = nullptr;
+    uint64_t map_size = 0;
+#ifdef _WIN32
+    HANDLE mapping = nullptr;
+#endif
+    unique_ptr<AlignedBuffer> buf = make_unique<AlignedBuffer>(IO_BUFFER_SIZE);
+    size_t used = 0;
+
+    void write_all(const uint8_t* p, size_t n);
+};
@@ -0,0 +1,308 @@
+#include <bits/stdc++.h>
+#include "fse.h"
+
+using namespace std;
+
+// Bits needed for v (0 for 0).
+static inline int _bit_width(uint64_t v) {
+    int n = 0;
+    for (; v; v >>= 1) n++;
+    return n;
+}
+
+// Spread the symbols over the L states, each symbol's spaced out so the
+// states of one symbol cover the range evenly.  The step is odd, so it
+// visits every state of the power-of-two table once.
+static void _spread_symbols(const uint16_t* norm, int n, int table_log, uint16_t* spread) {
+    uint32_t size = 1u << table_log, mask = size - 1, step = (size >> 1) + (size >> 3) + 3, pos = 0;
+    for (int s = 0; s < n; s++) {
+        for (int k = 0; k < norm[s]; k++) {
+            spread[pos] = (uint16_t)s;
+            pos = (pos + step) & mask;
+        }
+    }
+}
+
+// Scale `freq` to counts summing to 2^table_log, every used symbol at
+// least 1.  The rounding error goes to the largest count, where a count more
+// or less costs the least.  If that would take away half of it (many rare
+// symbols rounded up to 1), counts are taken from the largest one at a time.
+static void _normalize_counts(const uint32_t* freq, int n, int table_log, uint16_t* norm) {
+    uint64_t total = 0;
+    for (int s = 0; s < n; s++) total += freq[s];
+    int64_t size = (int64_t)1 << table_log, sum = 0;
+    if (total == 0) {
+        fill(norm, norm + n, 0);
+        norm[0] = (uint16_t)size;   // nothing to code; any valid table will do
+        return;
+    }
+    int largest = 0;
+    for (int s = 0; s < n; s++) {
+        norm[s] = freq[s] ? (uint16_t)max<uint64_t>(1, (freq[s] * size + total / 2) / total) : 0;
+        sum += norm[s];
+        if (norm[s] > norm[largest]) largest = s;
+    }
+    if (2 * (size - sum) > -(int64_t)norm[largest]) {
+        norm[largest] = (uint16_t)(norm[largest] + size - sum);
+        return;
+    }
+    for (; sum > size; sum--) norm[max_element(norm, norm + n) - norm]--;
+}
+
+// Table for symbols [0, n) with counts `freq`: the table size grows with the
+// number of symbols coded, from FSE_MIN_TABLE_LOG to `max_log`, and is at
+// least twice the number of symbols used.
+void build_fse_table(const uint32_t* freq, int n, int max_log, FseTable& t) {
+    uint64_t total = 0;
+    int used = 0;
+    for (int s = 0; s < n; s++) {
+        total += freq[s];
+        used += freq[s] != 0;
+    }
+    int log = total > 1 ? _bit_width(total - 1) - 2 : 0;
+    log = max(log, _bit_width((unsigned)used) + 1);
+    log = min(max(log, FSE_MIN_TABLE_LOG), max_log);
+    t.table_log = log;
+    t.n = n;
+    _normalize_counts(freq, n, log, t.norm);
+
+    uint32_t size = 1u << log;
+    uint16_t spread[1 << FSE_MAX_TABLE_LOG];
+    _spread_symbols(t.norm, n, log, spread);
+    int start[MAX_ALPHABET + 1];
+    start[0] = 0;
+    for (int s = 0; s < n; s++) {
+        start[s + 1] = start[s] + t.norm[s];
+        uint32_t c = t.norm[s];
+        // Sending max_out bits takes x below 2c; one fewer once x < c << max_out.
+        uint32_t max_out = c ? log + 1 - (uint32_t)_bit_width(c - 1) : 0;
+        t.delta_bits[s] = c ? (max_out << 16) - (c << max_out) : 0;
+        t.delta_state[s] = start[s] - (int32_t)c;
+    }
+    // The k-th state of a symbol, in table order, is the one the decoder
+    // reaches from count + k.
+    for (uint32_t u = 0; u < size; u++) t.next_state[start[spread[u]]++] = (uint16_t)(size + u);
+}
+
+// Order-0 entropy of symbols with counts `freq`: the fewest bits any coder
+// of them spends.
+double entropy_bits(const uint32_t* freq, int n) {
+    double total = 0, bits = 0;
+    for (int s = 0; s < n; s++) total += freq[s];
+    for (int s = 0; s < n; s++)
+        if (freq[s]) bits += freq[s] * log2(total / freq[s]);
+    return bits;
+}
+
+// Estimated data bits of coding symbols with counts `freq` with `t`; tANS
+// comes within a fraction of a percent of it.
+double fse_data_bits(const uint32_t* freq, const FseTable& t) {
+    double bits = 0;
+    for (int s = 0; s < t.n; s++)
+        if (freq[s]) bits += freq[s] * (t.table_log - log2((double)t.norm[s]));
+    return bits;
+}
+
+// Header: table_log - FSE_MIN_TABLE_LOG in 3 bits, then the counts in
+// symbol order, each in as many bits as the count still to be handed out
+// needs, until it is all handed out (the rest are zero).  A zero count is
+// followed by the number of further zeros, Elias gamma coded plus one.
+static void _write_gamma(BitWriter& out, uint32_t v) {
+    int n = _bit_width(v);
+    out.write(0, n - 1);
+    out.write(v, n);
+}
+
+static bool _read_gamma(BitReader& in, uint32_t& v) {
+    int zeros = 0;
+    while (in.read(1) == 0) {
+        if (++zeros > 24 || in.overrun()) return false;
+    }
+    v = (uint32_t)((1u << zeros) | in.read(zeros));
+    return true;
+}
+
+void write_fse_counts(BitWriter& out, const FseTable& t) {
+    out.write(t.table_log - FSE_MIN_TABLE_LOG, 3);
+    uint32_t remaining = 1u << t.table_log;
+    for (int s = 0; s < t.n && remaining; s++) {
+        out.write(t.norm[s], _bit_width(remaining));
+        remaining -= t.norm[s];
+        if (t.norm[s]) continue;
+        int run = 0;
+        while (s + 1 + run < t.n && t.norm[s + 1 + run] == 0) run++;
+        _write_gamma(out, run + 1);
+        s += run;
+    }
+}
+
+// Read counts for an alphabet of n symbols; false unless they are valid.
+bool read_fse_counts(BitReader& in, int n, uint16_t* norm, int& table_log) {
+    table_log = FSE_MIN_TABLE_LOG + (int)in.read(3);
+    if (table_log > FSE_MAX_TABLE_LOG) return false;
+    fill(norm, norm + n, 0);
+    uint32_t remaining = 1u << table_log;
+    for (int s = 0; s < n && remaining; s++) {
+        uint32_t c = (uint32_t)in.read(_bit_width(remaining));
+        if (c > remaining) return false;
+        norm[s] = (uint16_t)c;
+        remaining -= c;
+        if (c) continue;
+        uint32_t run;
+        if (!_read_gamma(in, run) || run - 1 > (uint32_t)(n - 1 - s)) return false;
+        s += run - 1;
+    }
+    return remaining == 0 && !in.overrun();
+}
+
+void FseDecoder::build(const uint16_t* norm, int n, int log) {
+    table_log = log;
+    uint32_t size = 1u << log;
+    uint16_t spread[1 << FSE_MAX_TABLE_LOG];
+    _spread_symbols(norm, n, log, spread);
+    uint32_t next[MAX_ALPHABET];
+    for (int s = 0; s < n; s++) next[s] = norm[s];
+    table.resize(size);
+    for (uint32_t u = 0; u < size; u++) {
+        int s = spread[u];
+        uint32_t state = next[s]++;
+        int bits = log + 1 - _bit_width(state);
+        table[u] = { (uint16_t)((state << bits) - size), (uint16_t)s, (uint8_t)bits };
+    }
+}
+
+// The coded bits, gathered as the encoder emits them, last to first: each
+// value goes in front of those before it.  Whole 32-bit words are stored
+// from the end of `buf` down, so it needs room for `max_bits` bits and no
+// more.
+class _FseReverseBits {
+public:
+    _FseReverseBits(vector<uint8_t>& buf, uint64_t max_bits) {
+        buf.resize(max_bits / 8 + 1);
+        p = end = buf.data() + buf.size();
+    }
+
+    // `value` must fit in `n` bits, n <= 32.
+    void add(uint64_t value, int n) {
+        acc |= value << count;
+        count += n;
+        if (count >= 32) {
+            p -= 4;
+            for (int i = 0; i < 4; i++) p[i] = (uint8_t)(acc >> (24 - 8 * i));
+            acc >>= 32;
+            count -= 32;
+        }
+    }
+
+    // Write the final states, then the bits in the order the decoder reads
+    // them.
+    void write(BitWriter& out, const uint32_t* states, const int* logs, int n_states) {
+        for (int i = 0; i < n_states; i++) out.write(states[i] - (1u << logs[i]), logs[i]);
+        out.write(acc, count);
+        BitSink sink = out.sink(end - p);
+        for (; end - p >= 8; p += 7) {
+            sink.put(_load_be64(p) >> 8, 56);
+            sink.flush();
+        }
+        for (; p < end; p++) sink.put(*p, 8);
+        if (sink.count) sink.flush();
+        out.commit(sink);
+    }
+
+private:
+    uint8_t *p, *end;
+    uint64_t acc = 0;
+    int count = 0;
+};
+
+// Byte data in two states, even positions in the first.  `scratch` holds the
+// coded bits, at most one more per byte than they take.
+void fse_encode_bytes(const FseTable& t, const uint8_t* data, size_t size, BitWriter& out, vector<uint8_t>& scratch) {
+    uint32_t freq[256] = {};
+    histogram(data, size, freq);
+    uint64_t max_bits = 0;
+    for (int s = 0; s < 256; s++) max_bits += (uint64_t)freq[s] * t.max_bits(s);
+    _FseReverseBits bits(scratch, max_bits);
+    uint32_t state[2] = { 1u << t.table_log, 1u << t.table_log };
+    uint32_t even = state[0], odd = state[1];
+    size_t i = size;
+    int n0, n1;
+    if (i & 1) {
+        i--;
+        uint32_t v = t.encode(even, data[i], n0);
+        bits.add(v, n0);
+    }
+    while (i > 0) {
+        i -= 2;
+        uint32_t v1 = t.encode(odd, data[i + 1], n1);
+        uint32_t v0 = t.encode(even, data[i], n0);
+        bits.add(v1, n1);
+        bits.add(v0, n0);
+    }
+    state[0] = even;
+    state[1] = odd;
+    int logs[2] = { t.table_log, t.table_log };
+    bits.write(out, state, logs, 2);
+}
+
+// Decode `count` bytes coded by fse_encode_bytes.  Returns false on invalid
+// or truncated input.
+bool fse_decode_bytes(const FseDecoder& dec, BitReader& in, uint8_t* dst, size_t count) {
+    FseState even(dec, in), odd(dec, in);
+    int bad = 0;
+    size_t i = 0;
+    // Four symbols of at most 12 bits to a refill.
+    for (; i + 4 <= count; i += 4) {
+        in.refill();
+        int s0 = even.decode_buffered(in), s1 = odd.decode_buffered(in);
+        int s2 = even.decode_buffered(in), s3 = odd.decode_buffered(in);
+        bad |= s0 | s1 | s2 | s3;
+        dst[i] = (uint8_t)s0;
+        dst[i + 1] = (uint8_t)s1;
+        dst[i + 2] = (uint8_t)s2;
+        dst[i + 3] = (uint8_t)s3;
+    }
+    for (; i < count; i++) {
+        int s = (i & 1 ? odd : even).decode(in);
+        bad |= s;
+        dst[i] = (uint8_t)s;
+    }
+    return !(bad & ~255) && !in.overrun();
+}
+
+// LZ77 tokens: per token the decoder reads the literal / length symbol's
+// state bits, the length's extra bits, then the distance symbol's state bits
+// and its extra bits, so they are emitted in the reverse of that order.
+// `scratch` holds the coded bits, as for fse_encode_bytes.
+void fse_encode_tokens(const FseTable& lit, const FseTable& dist, const vector<LZToken>& tokens, BitWriter& out,
+    vector<uint8_t>& scratch) {
+    uint64_t max_bits = 0;
+    for (auto& t : tokens) {
+        if (t.is_literal) {
+            max_bits += lit.max_bits((unsigned char)t.literal);
+            continue;
+        }
+        int lc = length_code(t.length), dc = dist_code(t.distance);
+        max_bits += lit.max_bits(256 + lc) + LENGTH_CODES[lc].extra + dist.max_bits(dc) + DIST_CODES[dc].extra;
+    }
+    _FseReverseBits bits(scratch, max_bits);
+    uint32_t state[2] = { 1u << lit.table_log, 1u << dist.table_log };
+    int n;
+    for (size_t i = tokens.size(); i-- > 0;) {
+        const LZToken& t = tokens[i];
+        if (t.is_literal) {
+            uint32_t v = lit.encode(state[0], (unsigned char)t.literal, n);
+            bits.add(v, n);
+            continue;
+        }
+        int lc = length_code(t.length), dc = dist_code(t.distance);
+        bits.add(t.distance - DIST_CODES[dc].base, DIST_CODES[dc].extra);
+        uint32_t v = dist.encode(state[1], dc, n);
+        bits.add(v, n);
+        bits.add(t.length - LENGTH_CODES[lc].base, LENGTH_CODES[lc].extra);
+        v = lit.encode(state[0], 256 + lc, n);
+        bits.add(v, n);
+    }
+    int logs[2] = { lit.table_log, dist.table_log };
+    bits.write(out, state, logs, 2);
+}
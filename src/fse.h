@@ -0,0 +1,108 @@
+/*
+Table-based asymmetric numeral systems (tANS, the coder of FSE): the entropy
+coder beside Huffman.  A Huffman code spends a whole number of bits on every
+symbol, which costs most on skewed alphabets (a symbol of probability 0.9
+still takes a bit); tANS spends about -log2(p) bits, fractions included.
+
+The coder is a state machine over L = 2^table_log states.  Each symbol owns
+as many states as its normalized count; decoding a state yields its symbol
+and the number of bits to read for the next state, one table lookup like the
+Huffman decoder's.  Encoding runs backwards, from the last symbol to the
+first, so the encoder gathers the bits it emits back to front in a byte
+buffer, in the order the decoder reads them; the decoder starts from the
+encoder's final state, sent ahead of the data.
+
+build_fse_table: normalized counts and encoding tables from frequencies.
+write_fse_counts / read_fse_counts: the header carrying the normalized counts.
+FseDecoder / FseState: decoding table, and a decoding state over one, which
+                       decodes symbols like HuffDecoder (decode(BitReader&)),
+                       so decode_lz77 takes either.
+fse_encode_bytes / fse_decode_bytes: Huffman-only data in two interleaved
+                       states, so two lookups are in flight at once.
+fse_encode_tokens: LZ77 tokens with one state for literals and lengths and
+                       one for distances, extra bits in between.
+*/
+
+#pragma once
+#include <bits/stdc++.h>
+#include "huffman.h"
+
+using namespace std;
+
+const int FSE_MIN_TABLE_LOG = 5;
+const int FSE_MAX_TABLE_LOG = 12;
+
+struct FseTable {
+    int table_log = 0;
+    int n = 0;                            // alphabet size
+    uint16_t norm[MAX_ALPHABET];          // normalized counts, summing to 2^table_log
+    uint32_t delta_bits[MAX_ALPHABET];    // encode: bits sent from state x are (x + delta_bits) >> 16
+    int32_t delta_state[MAX_ALPHABET];    // encode: next state index, less (x >> bits)
+    uint16_t next_state[1 << FSE_MAX_TABLE_LOG];
+
+    // Encode `sym` from state x in [L, 2L): returns the low `bits` of x,
+    // which are sent, and moves x to the next state.
+    uint32_t encode(uint32_t& x, int sym, int& bits) const {
+        bits = (int)((x + delta_bits[sym]) >> 16);
+        uint32_t out = x & ((1u << bits) - 1);
+        x = next_state[(x >> bits) + delta_state[sym]];
+        return out;
+    }
+
+    // Most bits encode() sends for `sym`: those from the top state.
+    int max_bits(int sym) const { return (int)((delta_bits[sym] + (2u << table_log) - 1) >> 16); }
+};
+
+struct FseEntry {
+    uint16_t base;     // next state, less the bits read
+    uint16_t symbol;
+    uint8_t bits;
+};
+
+class FseDecoder {
+public:
+    int table_log = 0;
+    vector<FseEntry> table;
+
+    // Build from counts summing to 2^table_log (read_fse_counts checks
+    // that).  Allocates nothing once the table has grown to size.
+    void build(const uint16_t* norm, int n, int log);
+};
+
+// One decoding state.  Starts from the encoder's final state, read from
+// the stream.
+class FseState {
+public:
+    FseState(const FseDecoder& dec, BitReader& in)
+        : table(dec.table.data()), log(dec.table_log), state((uint32_t)in.read(dec.table_log)) {}
+
+    bool empty() const { return false; }
+
+    int decode(BitReader& in) {
+        in.ensure(log);
+        return decode_buffered(in);
+    }
+
+    // decode() for a reader already holding at least table_log bits.
+    int decode_buffered(BitReader& in) {
+        FseEntry e = table[state];
+        state = e.base + (uint32_t)(in.peek(56) >> (56 - e.bits));
+        in.consume(e.bits);
+        return e.symbol;
+    }
+
+private:
+    const FseEntry* table;
+    int log;
+    uint32_t state;
+};
+
+void build_fse_table(const uint32_t* freq, int n, int max_log, FseTable& t);
+double entropy_bits(const uint32_t* freq, int n);
+double fse_data_bits(const uint32_t* freq, const FseTable& t);
+void write_fse_counts(BitWriter& out, const FseTable& t);
+bool read_fse_counts(BitReader& in, int n, uint16_t* norm, int& table_log);
+void fse_encode_bytes(const FseTable& t, const uint8_t* data, size_t size, BitWriter& out, vector<uint8_t>& scratch);
+bool fse_decode_bytes(const FseDecoder& dec, BitReader& in, uint8_t* dst, size_t count);
+void fse_encode_tokens(const FseTable& lit, const FseTable& dist, const vector<LZToken>& tokens, BitWriter& out,
+    vector<uint8_t>& scratch);
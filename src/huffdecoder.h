@@ -0,0 +1,162 @@
+/*
+Table-driven Huffman decoder.
+
+HuffDecoder resolves a symbol by indexing a lookup table with the next
+ROOT_BITS bits of the stream.  Codes that fit in the root table decode with
+a single lookup; longer codes hit a link entry that points at a secondary
+table indexed by the following bits (nested as deep as the code lengths
+require).  Works for any prefix code given as a dense BitCode table.
+
+Entry layout (uint32_t):
+  bits  0-5   bits to consume at this level (0 = no code, invalid input)
+  bits  6-11  link only: index bits of the next-level table
+  bit   12    link flag
+  bits 13-31  symbol, or offset of the next-level table for links
+*/
+
+#pragma once
+#include <bits/stdc++.h>
+#include "bitio.h"
+
+using namespace std;
+
+class HuffDecoder {
+public:
+    static constexpr int ROOT_BITS = 11;
+    static constexpr int SUB_BITS  = 8;
+    static constexpr int MAX_CODE_LEN = 56;   // BitReader::peek limit
+
+    // Build from codes[sym] = { bits, len }; len 0 marks unused symbols.
+    // Returns false if the codes are not a usable prefix code.
+    bool build(const vector<BitCode>& codes) {
+        list.clear();
+        for (int sym = 0; sym < (int)codes.size(); sym++) {
+            if (codes[sym].len == 0) continue;
+            if (codes[sym].len > MAX_CODE_LEN) return false;
+            list.push_back({ codes[sym], sym });
+        }
+        // Codes sharing a table index must be adjacent: order them as
+        // left-aligned bit strings.
+        sort(list.begin(), list.end(), [](const Entry& a, const Entry& b) {
+            return a.code.bits << (64 - a.code.len) < b.code.bits << (64 - b.code.len);
+        });
+        return build_sorted();
+    }
+
+    // Build the canonical code for lengths[0, n) (see canonical_codes()).
+    // Allocates nothing once the tables have grown to size.
+    bool build(const uint8_t* lengths, int n) {
+        int count[MAX_CODE_LEN + 1] = {};
+        for (int sym = 0; sym < n; sym++) {
+            if (lengths[sym] > MAX_CODE_LEN) return false;
+            count[lengths[sym]]++;
+        }
+        count[0] = 0;
+        // Canonical codes in (length, symbol) order are already sorted as
+        // left-aligned bit strings.
+        int first[MAX_CODE_LEN + 1];
+        uint64_t next[MAX_CODE_LEN + 1];
+        uint64_t code = 0;
+        int at = 0;
+        for (int len = 1; len <= MAX_CODE_LEN; len++) {
+            code = (code + count[len - 1]) << 1;
+            next[len] = code;
+            first[len] = at;
+            at += count[len];
+        }
+        list.resize(at);
+        for (int sym = 0; sym < n; sym++) {
+            int len = lengths[sym];
+            if (len) list[first[len]++] = { { next[len]++, len }, sym };
+        }
+        return build_sorted();
+    }
+
+    bool empty() const { return table.empty(); }
+
+    // Longest code, so callers can refill once for several symbols.
+    int max_code_len() const { return max_len; }
+
+    // Decode one symbol, or return -1 on a bit pattern that is not a code.
+    int decode(BitReader& in) const {
+        in.ensure(max_len);
+        return decode_buffered(in);
+    }
+
+    // decode() for a reader already holding at least max_code_len() bits.
+    int decode_buffered(BitReader& in) const {
+        uint32_t e = table[in.peek(root_bits)];
+        while (e & LINK) {
+            in.consume(e & 63);
+            e = table[(e >> 13) + in.peek((e >> 6) & 63)];
+        }
+        int n = e & 63;
+        if (n == 0) return -1;
+        in.consume(n);
+        return (int)(e >> 13);
+    }
+
+private:
+    static constexpr uint32_t LINK = 1u << 12;
+
+    struct Entry {
+        BitCode code;
+        int sym;
+    };
+
+    vector<uint32_t> table;
+    vector<Entry> list;   // codes being placed, reused between builds
+    int root_bits = 0;
+    int max_len = 0;
+
+    bool build_sorted() {
+        table.clear();
+        max_len = 0;
+        for (const Entry& e : list) max_len = max(max_len, e.code.len);
+        if (list.empty()) return true;
+        root_bits = min(ROOT_BITS, max_len);
+        table.assign((size_t)1 << root_bits, 0);
+        return fill(0, list.size(), 0, 0, root_bits);
+    }
+
+    // Fill the table at `base` (index bits `bits`) with list[lo, hi), whose
+    // first `depth` bits have already been consumed.  Codes longer than the
+    // table continue in a sub-table per index.
+    bool fill(size_t lo, size_t hi, size_t base, int depth, int bits) {
+        size_t i = lo;
+        while (i < hi) {
+            const BitCode& code = list[i].code;
+            int rest = code.len - depth;
+            uint64_t rem = code.bits & ((1ull << rest) - 1);
+            if (rest <= bits) {
+                size_t first = (size_t)(rem << (bits - rest));
+                size_t span = (size_t)1 << (bits - rest);
+                for (size_t k = first; k < first + span; k++) {
+                    if (table[base + k] != 0) return false;   // not prefix-free
+                    table[base + k] = ((uint32_t)list[i].sym << 13) | (uint32_t)rest;
+                }
+                i++;
+                continue;
+            }
+            uint64_t index = rem >> (rest - bits);
+            size_t j = i;
+            int longest = 0;
+            while (j < hi) {
+                const BitCode& c = list[j].code;
+                int r = c.len - depth;
+                if (r <= bits || ((c.bits & ((1ull << r) - 1)) >> (r - bits)) != index) break;
+                longest = max(longest, r - bits);
+                j++;
+            }
+            if (table[base + index] != 0) return false;
+            int sub_bits = min(SUB_BITS, longest);
+            size_t offset = table.size();
+            if (offset >= (1u << 19)) return false;
+            table.resize(offset + ((size_t)1 << sub_bits), 0);
+            table[base + index] = ((uint32_t)offset << 13) | LINK | ((uint32_t)sub_bits << 6) | (uint32_t)bits;
+            if (!fill(i, j, offset, depth + bits, sub_bits)) return false;
+            i = j;
+        }
+        return true;
+    }
+};
@@ -1,219 +1,445 @@
-/*
-File with functions for huffman encoding and decoding.
-generate_tree: takes in symbols, their frequencies and generates a huffman tree with codes for each symbol.
-encode: takes in a huffman tree and a string and encodes the string to a binary string.
-decode: takes in a huffman tree and a binary string and decodes it to the original string.
-*/
-
 #include <bits/stdc++.h>
+#include "huffman.h"
 
 using namespace std;
 
-struct Node {
-    int symbol;
-    int freq;
-    Node* left;
-    Node* right;
-    string code;
-};
-
-struct Compare {
-    bool operator()(Node* a, Node* b) {
-        return a->freq > b->freq;
+// --------------------------------------------------------------------------
+// Code construction
+//
+// Tables are built over flat arrays with no heap allocation: symbols are
+// sorted by frequency into a stack array, the in-place Moffat-Katajainen
+// algorithm turns the sorted weights into code lengths, package-merge works
+// in fixed scratch arrays when the lengths must be limited, and canonical
+// codes go into a dense CodeTable.  The vector versions below wrap these for
+// the code length header, the decoder and -v.
+// --------------------------------------------------------------------------
+
+// Used symbols of freq[0, n) in increasing frequency order (ties by
+// symbol); returns how many there are.
+static int _sorted_symbols(const uint32_t* freq, int n, uint16_t* syms) {
+    int used = 0;
+    for (int s = 0; s < n; s++)
+        if (freq[s] > 0) syms[used++] = (uint16_t)s;
+    sort(syms, syms + used, [&](uint16_t a, uint16_t b) {
+        return freq[a] != freq[b] ? freq[a] < freq[b] : a < b;
+    });
+    return used;
+}
+
+// Optimal (unbounded) Huffman code lengths for freq[0, n), computed in place
+// (Moffat & Katajainen, "In-Place Calculation of Minimum-Redundancy Codes").
+// The weight array first holds the sorted frequencies, then parent indices
+// of the internal nodes, then internal node depths, and finally the leaf
+// depths.  Unused symbols get length 0; a single used symbol gets 1.
+void tree_code_lengths(const uint32_t* freq, int n, int* lengths) {
+    uint16_t syms[MAX_ALPHABET];
+    uint32_t a[MAX_ALPHABET] = {};
+    fill(lengths, lengths + n, 0);
+    int m = _sorted_symbols(freq, n, syms);
+    if (m == 0) return;
+    if (m == 1) { lengths[syms[0]] = 1; return; }
+    for (int k = 0; k < m; k++) a[k] = freq[syms[k]];
+
+    // Pass 1, left to right: combine the two lightest of the remaining leaves
+    // (from `leaf`) and internal nodes (from `root`) into node `next`.
+    a[0] += a[1];
+    int root = 0, leaf = 2;
+    for (int next = 1; next < m - 1; next++) {
+        if (leaf >= m || a[root] < a[leaf]) { a[next] = a[root]; a[root++] = next; }
+        else a[next] = a[leaf++];
+        if (leaf >= m || (root < next && a[root] < a[leaf])) { a[next] += a[root]; a[root++] = next; }
+        else a[next] += a[leaf++];
     }
-};
-
-struct LZToken {
-    bool is_literal;
-    char literal;
-    int distance;
-    int length;
-};
-
-Node* generate_tree(const vector<int>& freq) {
-    priority_queue<Node*, vector<Node*>, Compare> pq;
-    for (int i = 0; i < freq.size(); i++) {
-        if (freq[i] > 0) {
-            Node* n = new Node{ i, freq[i], nullptr, nullptr, "" };
-            pq.push(n);
+    // Pass 2, right to left: parent indices become internal node depths.
+    a[m - 2] = 0;
+    for (int next = m - 3; next >= 0; next--) a[next] = a[a[next]] + 1;
+    // Pass 3: each level's free slots that are not internal nodes are leaves,
+    // assigned from the heaviest symbol down.
+    int avail = 1, used = 0, depth = 0, next = m - 1;
+    root = m - 2;
+    while (avail > 0) {
+        while (root >= 0 && (int)a[root] == depth) { used++; root--; }
+        while (avail > used) { a[next--] = depth; avail--; }
+        avail = 2 * used;
+        depth++;
+        used = 0;
+    }
+    for (int k = 0; k < m; k++) lengths[syms[k]] = (int)a[k];
+}
+
+// Package-merge (Larmore & Hirschberg): optimal code lengths subject to
+// every length being at most `max_len`.
+//
+// Level max_len-1 holds the used symbols sorted by frequency.  Each level
+// above merges the symbols with "packages" formed by pairing adjacent items
+// of the level below.  Taking the 2n-2 cheapest items of the top level and
+// following the packages down, a symbol's code length is the number of
+// levels at which it is taken.  Only two levels of weights are live at a
+// time; the leaf/package flags of every level are kept for the walk down.
+const int PM_MAX_LEVELS = 16;
+
+void package_merge_lengths(const uint32_t* freq, int n, int max_len, uint8_t* lengths) {
+    uint16_t syms[MAX_ALPHABET];
+    uint64_t weight[2][2 * MAX_ALPHABET];
+    bool is_leaf[PM_MAX_LEVELS][2 * MAX_ALPHABET];
+    int count[PM_MAX_LEVELS];
+
+    fill(lengths, lengths + n, 0);
+    int m = _sorted_symbols(freq, n, syms);
+    if (m == 0) return;
+    if (m == 1) { lengths[syms[0]] = 1; return; }
+    while ((1 << max_len) < m) max_len++;
+    max_len = min(max_len, PM_MAX_LEVELS);
+
+    for (int level = max_len - 1; level >= 0; level--) {
+        uint64_t* w = weight[level & 1];
+        const uint64_t* below = weight[(level + 1) & 1];
+        int packages = level == max_len - 1 ? 0 : count[level + 1] / 2;
+        int i = 0, j = 0, k = 0;
+        while (i < m || j < packages) {
+            uint64_t pw = j < packages ? below[2 * j] + below[2 * j + 1] : 0;
+            if (j == packages || (i < m && freq[syms[i]] <= pw)) {
+                w[k] = freq[syms[i++]];
+                is_leaf[level][k++] = true;
+            }
+            else {
+                w[k] = pw;
+                is_leaf[level][k++] = false;
+                j++;
+            }
         }
+        count[level] = k;
     }
-    while (pq.size() > 1) {
-        Node* l = pq.top(); pq.pop();
-        Node* r = pq.top(); pq.pop();
-        Node* parent = new Node{ -1, l->freq + r->freq, l, r, "" };
-        pq.push(parent);
+
+    int take = 2 * m - 2;
+    for (int level = 0; level < max_len && take > 0; level++) {
+        int leaves = 0, packages = 0;
+        for (int k = 0; k < take; k++) {
+            if (is_leaf[level][k]) leaves++;
+            else packages++;
+        }
+        for (int k = 0; k < leaves; k++) lengths[syms[k]]++;
+        take = 2 * packages;
     }
-    if (pq.empty()) return nullptr;
-    return pq.top();
 }
 
-void build_codes(Node* root, map<int, string>& codes, string code = "") {
-    if (!root) return;
-    // Handle single node tree (only one unique symbol)
-    if (root->left == nullptr && root->right == nullptr) {
-        codes[root->symbol] = code.empty() ? "0" : code;
+// Huffman code lengths for freq[0, n), no longer than `max_len` bits.  The
+// unbounded tree is used when it already fits; otherwise package-merge
+// finds the best lengths within the limit.
+void huffman_code_lengths(const uint32_t* freq, int n, int max_len, uint8_t* lengths) {
+    int depth[MAX_ALPHABET];
+    tree_code_lengths(freq, n, depth);
+    if (*max_element(depth, depth + n) <= max_len) {
+        for (int s = 0; s < n; s++) lengths[s] = (uint8_t)depth[s];
         return;
     }
-    build_codes(root->left, codes, code + "0");
-    build_codes(root->right, codes, code + "1");
+    package_merge_lengths(freq, n, max_len, lengths);
 }
 
-string encode(const map<int, string>& codes, const vector<int>& symbols) {
-    string res;
-    for (int s : symbols) {
-        res += codes.at(s);
+// Canonical code assignment (RFC 1951, 3.2.2): codes of equal length are
+// consecutive integers in symbol order, and shorter codes sort before longer
+// ones, so the lengths alone determine every code.
+void canonical_codes(const uint8_t* lengths, int n, uint32_t* codes) {
+    uint32_t count[MAX_CODE_LEN + 2] = {};
+    uint32_t next[MAX_CODE_LEN + 2] = {};
+    for (int s = 0; s < n; s++) count[lengths[s]]++;
+    count[0] = 0;
+    uint32_t code = 0;
+    for (int len = 1; len <= MAX_CODE_LEN + 1; len++) {
+        code = (code + count[len - 1]) << 1;
+        next[len] = code;
     }
-    return res;
+    for (int s = 0; s < n; s++) codes[s] = lengths[s] ? next[lengths[s]]++ : 0;
 }
 
-string decode_huffman(Node* root, const string& binary) {
-    string res;
-    if (!root) return res;
+// Length-limited code for freq[0, n) in a dense table.
+void build_code_table(const uint32_t* freq, int n, int max_len, CodeTable& table) {
+    huffman_code_lengths(freq, n, max_len, table.len);
+    canonical_codes(table.len, n, table.code);
+}
 
-    // Handle single-node tree (only one unique symbol)
-    if (root->left == nullptr && root->right == nullptr) {
-        // Each bit represents one occurrence of the single symbol
-        for (size_t i = 0; i < binary.size(); i++) {
-            res += (char)root->symbol;
-        }
-        return res;
-    }
+vector<int> tree_code_lengths(const vector<int>& freq) {
+    vector<uint32_t> f(freq.begin(), freq.end());
+    vector<int> lengths(freq.size());
+    tree_code_lengths(f.data(), (int)f.size(), lengths.data());
+    return lengths;
+}
 
-    Node* curr = root;
-    for (char b : binary) {
-        if (b == '0') curr = curr->left;
-        else curr = curr->right;
-        if (curr->left == nullptr && curr->right == nullptr) {
-            res += (char)curr->symbol;
-            curr = root;
-        }
-    }
-    return res;
+vector<int> huffman_code_lengths(const vector<int>& freq, int max_len) {
+    vector<uint32_t> f(freq.begin(), freq.end());
+    vector<uint8_t> lengths(freq.size());
+    huffman_code_lengths(f.data(), (int)f.size(), max_len, lengths.data());
+    return vector<int>(lengths.begin(), lengths.end());
 }
 
-vector<LZToken> decode_lz_huffman(Node* root, const string& binary) {
-    vector<LZToken> tokens;
-    if (!root) return tokens;
+// --------------------------------------------------------------------------
+// Code length header
+//
+// The lengths are run-length coded with the DEFLATE code length alphabet:
+//   0-15  literal code length
+//   16    repeat the previous length 3-6 times   (2 extra bits)
+//   17    repeat a zero length 3-10 times        (3 extra bits)
+//   18    repeat a zero length 11-138 times      (7 extra bits)
+// and those symbols are themselves Huffman coded.  Layout:
+//   9 bits        number of lengths sent (trailing zero lengths are dropped)
+//   4 bits        number of code length code lengths sent, minus 4
+//   3 bits each   code length code lengths, in CL_ORDER
+//   ...           the run-length coded lengths
+// --------------------------------------------------------------------------
 
-    // Handle single-node tree (only one unique symbol)
-    bool single_node = (root->left == nullptr && root->right == nullptr);
+const int CL_SYMBOLS = 19;
+const int CL_ORDER[CL_SYMBOLS] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
 
-    int pos = 0;
-    while (pos < binary.size()) {
-        Node* curr = root;
+void write_code_lengths(BitWriter& out, const uint8_t* lengths, int n) {
+    int count = n;
+    while (count > 0 && lengths[count - 1] == 0) count--;
+    out.write(count, 9);
+    if (count == 0) return;
 
-        if (single_node) {
-            // Single node: each bit represents one occurrence of the symbol
-            pos++;
-        }
-        else {
-            while (curr->left || curr->right) {
-                if (binary[pos] == '0') curr = curr->left;
-                else curr = curr->right;
-                pos++;
-                if (pos >= binary.size()) break;
-            }
+    // Run-length code into (symbol, extra bits) pairs; at most two per length.
+    pair<int, int> rle[2 * MAX_ALPHABET];
+    int rle_count = 0;
+    for (int i = 0; i < count;) {
+        int len = lengths[i];
+        int run = 1;
+        while (i + run < count && lengths[i + run] == len) run++;
+        if (len == 0 && run >= 3) {
+            run = min(run, 138);
+            rle[rle_count++] = run >= 11 ? make_pair(18, run - 11) : make_pair(17, run - 3);
         }
-
-        if (curr->symbol < 256) {
-            tokens.push_back({ true, (char)curr->symbol, 0, 0 });
+        else if (len != 0 && run >= 4) {
+            rle[rle_count++] = { len, 0 };
+            run = min(run - 1, 6) + 1;
+            rle[rle_count++] = { 16, run - 1 - 3 };
         }
         else {
-            int length = curr->symbol - 256 + 3;
-            int distance = 0;
-            int bits_read = 0;
-            for (int i = 0; i < 24; i++) {
-                if (pos >= binary.size()) break;
-                distance |= (binary[pos] - '0') << (23 - i);
-                pos++;
-                bits_read++;
-            }
-            // Only emit the token if all 24 distance bits were present.
-            // Incomplete distances arise from byte-alignment padding and
-            // indicate we have reached the end of the real data.
-            if (bits_read == 24)
-                tokens.push_back({ false, 0, distance, length });
+            run = 1;
+            rle[rle_count++] = { len, 0 };
         }
+        i += run;
+    }
+
+    uint32_t cl_freq[CL_SYMBOLS] = {};
+    for (int i = 0; i < rle_count; i++) cl_freq[rle[i].first]++;
+    CodeTable cl;
+    build_code_table(cl_freq, CL_SYMBOLS, 7, cl);
+
+    int cl_count = CL_SYMBOLS;
+    while (cl_count > 4 && cl.len[CL_ORDER[cl_count - 1]] == 0) cl_count--;
+    out.write(cl_count - 4, 4);
+    for (int i = 0; i < cl_count; i++) out.write(cl.len[CL_ORDER[i]], 3);
+
+    for (int i = 0; i < rle_count; i++) {
+        auto [sym, extra] = rle[i];
+        out.write(cl.code[sym], cl.len[sym]);
+        if (sym == 16) out.write(extra, 2);
+        else if (sym == 17) out.write(extra, 3);
+        else if (sym == 18) out.write(extra, 7);
     }
-    return tokens;
 }
 
-vector<LZToken> lz77_compress(const string& data, int window_size = 4096, int max_length = 34) {
-    vector<LZToken> tokens;
-    size_t i = 0;
-    while (i < data.size()) {
-        int max_len = 0;
-        int best_dist = 0;
-        size_t start = (i > window_size) ? i - window_size : 0;
-        for (size_t j = start; j < i; j++) {
-            int len = 0;
-            while (i + len < data.size() && len < max_length && data[j + len] == data[i + len]) len++;
-            if (len > max_len) {
-                max_len = len;
-                best_dist = i - j;
-            }
+// Read `alphabet_size` code lengths written by write_code_lengths.
+// Returns false on a malformed header.
+bool read_code_lengths(BitReader& in, int alphabet_size, uint8_t* lengths) {
+    memset(lengths, 0, alphabet_size);
+    int count = (int)in.read(9);
+    if (count > alphabet_size) return false;
+    if (count == 0) return true;
+
+    // The code length code is at most 7 bits long, so one 128-entry table
+    // of (symbol << 3 | length) decodes it.
+    int cl_count = (int)in.read(4) + 4;
+    uint8_t cl_lengths[CL_SYMBOLS] = {};
+    for (int i = 0; i < cl_count; i++) cl_lengths[CL_ORDER[i]] = (uint8_t)in.read(3);
+    uint32_t cl_codes[CL_SYMBOLS];
+    canonical_codes(cl_lengths, CL_SYMBOLS, cl_codes);
+    uint8_t cl_table[128] = {};
+    for (int sym = 0; sym < CL_SYMBOLS; sym++) {
+        int len = cl_lengths[sym];
+        if (len == 0) continue;
+        if (cl_codes[sym] >> len) return false;   // over-subscribed
+        uint32_t first = cl_codes[sym] << (7 - len);
+        for (uint32_t k = first; k < first + (1u << (7 - len)); k++) {
+            if (cl_table[k]) return false;
+            cl_table[k] = (uint8_t)(sym << 3 | len);
         }
-        if (max_len >= 3) {
-            tokens.push_back({ false, 0, best_dist, max_len });
-            i += max_len;
+    }
+
+    int i = 0;
+    while (i < count) {
+        in.ensure(7);
+        uint8_t e = cl_table[in.peek(7)];
+        if (e == 0) return false;
+        in.consume(e & 7);
+        int sym = e >> 3;
+        if (in.overrun()) return false;
+        if (sym < 16) {
+            lengths[i++] = (uint8_t)sym;
+            continue;
         }
-        else {
-            tokens.push_back({ true, data[i], 0, 0 });
-            i++;
+        int value = 0, run;
+        if (sym == 16) {
+            if (i == 0) return false;
+            value = lengths[i - 1];
+            run = 3 + (int)in.read(2);
         }
+        else if (sym == 17) run = 3 + (int)in.read(3);
+        else run = 11 + (int)in.read(7);
+        if (i + run > count) return false;
+        while (run-- > 0) lengths[i++] = (uint8_t)value;
     }
-    return tokens;
+    return true;
+}
+
+// Two table entries (code << 4 | length) joined into code << 5 | length.
+static inline uint64_t _join_codes(uint64_t a, uint64_t b) {
+    uint64_t lb = b & 15;
+    return ((a >> 4 << lb | b >> 4) << 5) | ((a & 15) + lb);
 }
 
-string lz77_decompress(const vector<LZToken>& tokens) {
-    string result;
-    for (auto& t : tokens) {
-        if (t.is_literal) {
-            result += t.literal;
+// Huffman-only coding of `size` bytes.  Each byte's code and length are
+// packed into one word of a 1 KiB table, and K codes are put between
+// flushes: four when every code fits in 14 bits, otherwise three.
+template <int K>
+static void _encode_bytes(const uint32_t* packed, const uint8_t* data, size_t size, BitSink& out) {
+    size_t i = 0;
+    for (; i + K <= size; i += K) {
+        // Join the codes pairwise (two short dependency chains) so the sink
+        // sees a single put per flush.
+        uint64_t g = _join_codes(packed[data[i]], packed[data[i + 1]]);
+        if (K == 4) {
+            uint64_t h = _join_codes(packed[data[i + 2]], packed[data[i + 3]]);
+            out.put((g >> 5 << (h & 31)) | h >> 5, (int)((g & 31) + (h & 31)));
         }
         else {
-            // Guard against spurious tokens produced by bit-padding.
-            if (t.distance == 0 || (size_t)t.distance > result.size()) continue;
-            size_t start = result.size() - t.distance;
-            for (int k = 0; k < t.length; k++) {
-                result += result[start + k];
-            }
+            uint64_t h = packed[data[i + 2]];
+            out.put((g >> 5 << (h & 15)) | h >> 4, (int)((g & 31) + (h & 15)));
         }
+        out.flush();
+    }
+    for (; i < size; i++) {
+        uint32_t e = packed[data[i]];
+        out.put(e >> 4, e & 15);
+        out.flush();
     }
-    return result;
 }
 
-// ==========================================================================
-// N-ary Huffman tree (arbitrary base)
-//
-// generate_tree_nary(freq, base) builds a base-n Huffman tree.
-// For base == 2 this is equivalent to the standard binary Huffman tree.
-//
-// The algorithm combines the `base` least-frequent nodes at every step.
-// To make the first merge consume exactly `base` nodes and every subsequent
-// merge reduce the queue by exactly (base - 1), we may need to pad with
-// a few dummy (freq = 0) nodes.  The padding condition is:
-//   (N - 1) mod (base - 1) == 0
-// If not satisfied, add  (base - 1) - ((N - 1) mod (base - 1))  dummies.
-// ==========================================================================
-
-struct NaryNode {
-    int symbol;      // leaf symbol; -1 = internal node; -2 = dummy padding
-    long long freq;
-    string code;
-    vector<NaryNode*> children; // empty for leaves
-};
-
-struct NaryCompare {
-    bool operator()(NaryNode* a, NaryNode* b) const {
-        return a->freq > b->freq; // min-heap
+void encode_bytes(const CodeTable& table, const uint8_t* data, size_t size, BitWriter& out) {
+    uint32_t packed[256];
+    int max_len = 0;
+    for (int s = 0; s < 256; s++) {
+        packed[s] = table.code[s] << 4 | table.len[s];
+        max_len = max(max_len, (int)table.len[s]);
     }
-};
+    BitSink sink = out.sink(size / 8 * max_len + max_len);
+    if (max_len <= 14) _encode_bytes<4>(packed, data, size, sink);
+    else _encode_bytes<3>(packed, data, size, sink);
+    out.commit(sink);
+}
+
+// Four-stream form of encode_bytes: quarter q of the data (_quarter) is coded
+// as its own stream, so a decoder can follow all four at once.  Starting at
+// a byte boundary, `out` gets a jump table with the byte sizes of the first
+// three streams (u32 little-endian each), then the four streams, each
+// zero-padded to a byte.
+static inline void _quarter(size_t size, int q, size_t& from, size_t& to) {
+    size_t quarter = (size + 3) / 4;
+    from = min(size, q * quarter);
+    to = min(size, from + quarter);
+}
+
+void encode_bytes4(const CodeTable& table, const uint8_t* data, size_t size, BitWriter& out) {
+    out.align();
+    size_t jump = out.bit_count() / 8;
+    for (int q = 0; q < 3; q++) out.write(0, 32);
+    size_t start = jump + JUMP_TABLE_SIZE;
+    for (int q = 0; q < 4; q++) {
+        size_t from, to;
+        _quarter(size, q, from, to);
+        encode_bytes(table, data + from, to - from, out);
+        out.align();
+        size_t end = out.bit_count() / 8;
+        if (q < 3)
+            for (int k = 0; k < 4; k++) out.out[jump + 4 * q + k] = (uint8_t)((end - start) >> (8 * k));
+        start = end;
+    }
+}
+
+// Decode up to `count` symbols into `dst`; returns how many were decoded
+// (fewer only on invalid or truncated input).
+size_t decode_huffman(const HuffDecoder& dec, BitReader& in, uint8_t* dst, size_t count) {
+    if (dec.empty()) return 0;
+    size_t i = 0;
+    while (i < count) {
+        int sym = dec.decode(in);
+        if (sym < 0 || sym >= 256 || in.overrun()) break;
+        dst[i++] = (uint8_t)sym;
+    }
+    return i;
+}
+
+// Decode `count` bytes coded by encode_bytes4 from p[0, size).  The four
+// streams are independent, so one symbol is decoded from each per step and
+// their table lookups overlap instead of waiting on one bit position.
+// Returns false on invalid or truncated input.
+bool decode_huffman4(const HuffDecoder& dec, const uint8_t* p, size_t size, uint8_t* dst, size_t count) {
+    if (dec.empty() || size < JUMP_TABLE_SIZE) return false;
+    size_t offset[5] = { JUMP_TABLE_SIZE };
+    for (int q = 0; q < 3; q++) {
+        uint32_t n = p[4 * q] | p[4 * q + 1] << 8 | p[4 * q + 2] << 16 | (uint32_t)p[4 * q + 3] << 24;
+        if (n > size - offset[q]) return false;
+        offset[q + 1] = offset[q] + n;
+    }
+    offset[4] = size;
+    BitReader in[4] = { BitReader(p + offset[0], offset[1] - offset[0]), BitReader(p + offset[1], offset[2] - offset[1]),
+        BitReader(p + offset[2], offset[3] - offset[2]), BitReader(p + offset[3], offset[4] - offset[3]) };
+    uint8_t* op[4];
+    size_t n[4];
+    for (int q = 0; q < 4; q++) {
+        size_t from, to;
+        _quarter(count, q, from, to);
+        op[q] = dst + from;
+        n[q] = to - from;
+    }
+
+    // The last quarter is the shortest; the others finish one at a time.
+    // With codes of up to 18 bits, one refill serves three symbols a stream.
+    int bad = 0;
+    size_t i = 0;
+    auto step = [&](int q) {
+        int sym = dec.decode_buffered(in[q]);
+        bad |= sym;
+        op[q][i] = (uint8_t)sym;
+    };
+    if (dec.max_code_len() <= 18) {
+        for (; i + 3 <= n[3];) {
+            for (int q = 0; q < 4; q++) in[q].refill();
+            for (int k = 0; k < 3; k++, i++) {
+                step(0);
+                step(1);
+                step(2);
+                step(3);
+            }
+        }
+    }
+    for (; i < n[3]; i++) {
+        for (int q = 0; q < 4; q++) in[q].ensure(dec.max_code_len());
+        step(0);
+        step(1);
+        step(2);
+        step(3);
+    }
+    if (bad & ~255) return false;
+    for (int q = 0; q < 3; q++)
+        if (decode_huffman(dec, in[q], op[q] + n[3], n[q] - n[3]) != n[q] - n[3]) return false;
+    for (int q = 0; q < 4; q++)
+        if (in[q].overrun()) return false;
+    return true;
+}
 
 // Build a base-n Huffman tree and return its root.
 // base must be >= 2.
-NaryNode* generate_tree_nary(const vector<int>& freq, int base = 2) {
+NaryNode* generate_tree_nary(const vector<int>& freq, int base) {
     if (base < 2) base = 2;
 
     priority_queue<NaryNode*, vector<NaryNode*>, NaryCompare> pq;
@@ -254,7 +480,7 @@ NaryNode* generate_tree_nary(const vector<int>& freq, int base = 2) {
 // Each child edge is labelled with its index digit (0 .. base-1).
 // Dummy nodes (symbol == -2) are skipped.
 void build_codes_nary(NaryNode* root, map<int, string>& codes,
-    const string& code = "") {
+    const string& code) {
     if (!root) return;
     if (root->children.empty()) {
         if (root->symbol >= 0) // skip dummy padding nodes
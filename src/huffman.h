@@ -0,0 +1,222 @@
+/*
+File with functions for huffman encoding and decoding.
+tree_code_lengths / package_merge_lengths: optimal code lengths, unbounded or length-limited, built in flat arrays.
+build_code_table: dense canonical {code, length} table for an alphabet, with no heap allocation.
+encode_bytes: Huffman-only coding of a byte buffer with a dense code table, unrolled several codes per flush.
+decode_huffman / decode_lz77: table-driven decoding into caller-owned buffers; LZ77 matches are copied as they are decoded.
+encode_bytes4 / decode_huffman4: Huffman-only coding in four interleaved streams behind a jump table, for large blocks.
+huffman_code_lengths / canonical_codes: code lengths from frequencies, and canonical codes from lengths.
+write_code_lengths / read_code_lengths: DEFLATE-style compact header carrying the code lengths.
+length_code / dist_code: map a match length / distance to its symbol.  A match is sent as the length symbol
+           (256 + length_code) and its LENGTH_CODES extra bits, then the distance symbol, Huffman coded with a
+           second per-block table, and its DIST_CODES extra bits.
+*/
+
+#pragma once
+#include <bits/stdc++.h>
+#include "bitio.h"
+#include "huffdecoder.h"
+#include "matchfinder.h"
+
+using namespace std;
+
+const int NUM_LENGTH_SYMBOLS = 60;   // match lengths MIN_MATCH..MAX_MATCH
+const int NUM_SYMBOLS  = 256 + NUM_LENGTH_SYMBOLS;  // literals + LZ77 length codes
+const int MAX_CODE_LEN = 15;   // longest code the length header can carry
+const int NUM_DIST_SYMBOLS = 48;   // distance codes, covering distances 1..MAX_WINDOW
+const int MAX_MATCH = MIN_MATCH + 65535;
+
+// A symbol that stands for the range [base, base + 2^extra).
+struct CodeRange {
+    int base;
+    int extra;   // number of raw bits following the symbol
+};
+
+static constexpr int _floor_log2(uint32_t v) {
+    int n = 0;
+    while (v >>= 1) n++;
+    return n;
+}
+
+// Length codes: codes 0-7 are lengths 3-10, and above that each group of
+// four codes splits a power-of-two range of (length - 3) into quarters.
+static constexpr array<CodeRange, NUM_LENGTH_SYMBOLS> _make_length_codes() {
+    array<CodeRange, NUM_LENGTH_SYMBOLS> codes{};
+    for (int c = 0; c < NUM_LENGTH_SYMBOLS; c++) {
+        if (c < 8) codes[c] = { MIN_MATCH + c, 0 };
+        else {
+            int extra = (c - 8) / 4 + 1;
+            codes[c] = { MIN_MATCH + ((4 + (c & 3)) << extra), extra };
+        }
+    }
+    return codes;
+}
+
+// Distance codes (RFC 1951, 3.2.5, extended to 48 codes): codes 0-3 are
+// distances 1-4, and above that each pair of codes splits a power-of-two
+// range in half.
+static constexpr array<CodeRange, NUM_DIST_SYMBOLS> _make_dist_codes() {
+    array<CodeRange, NUM_DIST_SYMBOLS> codes{};
+    for (int c = 0; c < NUM_DIST_SYMBOLS; c++) {
+        if (c < 4) codes[c] = { c + 1, 0 };
+        else {
+            int extra = c / 2 - 1;
+            codes[c] = { (2 + (c & 1)) * (1 << extra) + 1, extra };
+        }
+    }
+    return codes;
+}
+
+static constexpr array<CodeRange, NUM_LENGTH_SYMBOLS> LENGTH_CODES = _make_length_codes();
+static constexpr array<CodeRange, NUM_DIST_SYMBOLS> DIST_CODES = _make_dist_codes();
+
+inline int length_code(int length) {
+    int v = length - MIN_MATCH;
+    if (v < 8) return v;
+    int n = _floor_log2(v);
+    return 8 + 4 * (n - 3) + ((v >> (n - 2)) & 3);
+}
+
+inline int dist_code(int distance) {
+    int d = distance - 1;
+    if (d < 4) return d;
+    int n = _floor_log2(d);
+    return 2 * n + ((d >> (n - 1)) & 1);
+}
+
+struct LZToken {
+    bool is_literal;
+    char literal;
+    int distance;
+    int length;
+};
+
+const int MAX_ALPHABET = NUM_SYMBOLS;   // largest alphabet a table is built for
+
+// Dense canonical code table: code[s] is sent in len[s] bits, MSB first.
+struct CodeTable {
+    uint32_t code[MAX_ALPHABET];
+    uint8_t  len[MAX_ALPHABET];
+};
+
+void tree_code_lengths(const uint32_t* freq, int n, int* lengths);
+void package_merge_lengths(const uint32_t* freq, int n, int max_len, uint8_t* lengths);
+void huffman_code_lengths(const uint32_t* freq, int n, int max_len, uint8_t* lengths);
+void canonical_codes(const uint8_t* lengths, int n, uint32_t* codes);
+void build_code_table(const uint32_t* freq, int n, int max_len, CodeTable& table);
+vector<int> tree_code_lengths(const vector<int>& freq);
+vector<int> huffman_code_lengths(const vector<int>& freq, int max_len = MAX_CODE_LEN);
+
+void write_code_lengths(BitWriter& out, const uint8_t* lengths, int n);
+bool read_code_lengths(BitReader& in, int alphabet_size, uint8_t* lengths);
+
+// Size of the jump table in front of encode_bytes4's streams.
+const size_t JUMP_TABLE_SIZE = 3 * 4;
+
+void encode_bytes(const CodeTable& table, const uint8_t* data, size_t size, BitWriter& out);
+void encode_bytes4(const CodeTable& table, const uint8_t* data, size_t size, BitWriter& out);
+size_t decode_huffman(const HuffDecoder& dec, BitReader& in, uint8_t* dst, size_t count);
+bool decode_huffman4(const HuffDecoder& dec, const uint8_t* p, size_t size, uint8_t* dst, size_t count);
+
+// Copy the `length` bytes starting `distance` back to op.  When at least 16
+// bytes past the match still belong to the output, the copy moves whole 8- or
+// 16-byte words, and the last word may write past the match; those bytes are
+// overwritten by what is decoded next.  A distance shorter than a word is
+// widened to a multiple of itself first: the match repeats with that period.
+static inline void _copy_match(uint8_t* op, size_t distance, size_t length, const uint8_t* end) {
+    const uint8_t* from = op - distance;
+    if ((size_t)(end - op) < length + 16) {
+        for (size_t k = 0; k < length; k++) op[k] = from[k];
+        return;
+    }
+    if (distance >= 16) {
+        for (size_t k = 0; k < length; k += 16) memcpy(op + k, from + k, 16);
+    }
+    else if (distance >= 8) {
+        for (size_t k = 0; k < length; k += 8) memcpy(op + k, from + k, 8);
+    }
+    else if (distance == 1) {
+        memset(op, from[0], length);
+    }
+    else {
+        size_t period = distance * ((8 + distance - 1) / distance);   // 8 to 14
+        size_t k = 0;
+        for (; k < period && k < length; k++) op[k] = from[k];
+        for (; k < length; k += 8) memcpy(op + k, op + k - period, 8);
+    }
+}
+
+// Decode an LZ77 block straight into dst[0, size): literals are stored as
+// they are decoded and matches are copied in place, with no token buffer.
+// `dist_dec` decodes the distance symbol that follows each length.  The
+// decoders are HuffDecoders or FseStates (fse.cpp): anything with empty() and
+// a decode(BitReader&) that returns a symbol, or -1 on an invalid code.
+// dict[0, dict_size) is the history before dst (a dictionary), which matches
+// may reach into.  Returns false on invalid input, including a distance that
+// reaches before the history or output that does not come to exactly `size`
+// bytes.
+template <class Decoder, class DistDecoder>
+bool decode_lz77(Decoder& dec, DistDecoder& dist_dec, BitReader& in, uint8_t* dst, size_t size,
+    const uint8_t* dict = nullptr, size_t dict_size = 0) {
+    if (dec.empty()) return size == 0;
+    const uint8_t* end = dst + size;
+    size_t pos = 0;
+    while (pos < size) {
+        int sym = dec.decode(in);
+        if (sym < 0 || in.overrun()) return false;
+        if (sym < 256) {
+            dst[pos++] = (uint8_t)sym;
+            continue;
+        }
+        const CodeRange& lc = LENGTH_CODES[sym - 256];
+        size_t length = lc.base + in.read(lc.extra);
+        int dsym = dist_dec.empty() ? -1 : dist_dec.decode(in);
+        if (dsym < 0 || dsym >= NUM_DIST_SYMBOLS) return false;
+        size_t distance = DIST_CODES[dsym].base + in.read(DIST_CODES[dsym].extra);
+        if (length > size - pos) return false;
+        if (distance > pos) {
+            // The match starts in the dictionary and may run on into dst.
+            size_t back = distance - pos;
+            if (back > dict_size) return false;
+            size_t n = min(length, back);
+            memcpy(dst + pos, dict + dict_size - back, n);
+            pos += n;
+            length -= n;
+        }
+        _copy_match(dst + pos, distance, length, end);
+        pos += length;
+    }
+    return !in.overrun();
+}
+
+// ==========================================================================
+// N-ary Huffman tree (arbitrary base)
+//
+// generate_tree_nary(freq, base) builds a base-n Huffman tree.
+// For base == 2 this is equivalent to the standard binary Huffman tree.
+//
+// The algorithm combines the `base` least-frequent nodes at every step.
+// To make the first merge consume exactly `base` nodes and every subsequent
+// merge reduce the queue by exactly (base - 1), we may need to pad with
+// a few dummy (freq = 0) nodes.  The padding condition is:
+//   (N - 1) mod (base - 1) == 0
+// If not satisfied, add  (base - 1) - ((N - 1) mod (base - 1))  dummies.
+// ==========================================================================
+
+struct NaryNode {
+    int symbol;      // leaf symbol; -1 = internal node; -2 = dummy padding
+    long long freq;
+    string code;
+    vector<NaryNode*> children; // empty for leaves
+};
+
+struct NaryCompare {
+    bool operator()(NaryNode* a, NaryNode* b) const {
+        return a->freq > b->freq; // min-heap
+    }
+};
+
+NaryNode* generate_tree_nary(const vector<int>& freq, int base = 2);
+void build_codes_nary(NaryNode* root, map<int, string>& codes, const string& code = "");
+void free_tree_nary(NaryNode* root);
+double avg_code_length(const vector<int>& freq, const map<int, string>& codes);
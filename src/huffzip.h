@@ -0,0 +1,116 @@
+/*
+Embeddable huffzip library API.
+
+Compresses to and from memory in the same container format as the huffzip
+command line tool, so either side can read what the other wrote.
+
+HuffzipCompressor / HuffzipDecompressor are reusable contexts: they keep
+their match finder, Huffman tables and buffers between calls, so once a
+context and the caller's output vector have grown to the working size,
+compressing or decompressing more data of that size allocates nothing.
+A context is used by one thread at a time; use one context per thread.
+
+One-shot:
+    HuffzipCompressor c;
+    std::vector<uint8_t> packed;
+    huffzip_compress(c, data, size, packed);
+
+Streaming: write() takes input in pieces of any size and appends whatever
+output is complete to `out`; finish() flushes the rest (the last block,
+index and trailer for the compressor; the end-of-stream check for the
+decompressor) and leaves the context ready for the next stream.
+
+Dictionaries: a HuffzipDictionary trained on typical inputs (or loaded from
+a file written by `huffzip --train`) lets small inputs start with a warm
+LZ77 window and skip the code length header.  The compressed stream names
+the dictionary by id; a decompressor picks it from those added with
+add_dictionary().  A dictionary must outlive the contexts that use it.
+
+Every call returns false on error; error() then describes it, and the
+context must be reset() before it is used again.
+
+Build: link against the huffzip static library (CMake target huffzip_lib).
+*/
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class HuffzipDictionary {
+public:
+    HuffzipDictionary();
+    ~HuffzipDictionary();
+    HuffzipDictionary(HuffzipDictionary&&) noexcept;
+    HuffzipDictionary& operator=(HuffzipDictionary&&) noexcept;
+
+    // Load the contents of a dictionary file; false if it is not valid.
+    bool load(const void* data, size_t size);
+    // Build from sample inputs, with up to `size` bytes of content; `id` 0
+    // derives the id from the dictionary.  False if there are no samples.
+    bool train(const std::vector<std::vector<uint8_t>>& samples, size_t size = 32 << 10, int level = 6,
+        uint32_t id = 0);
+    // The dictionary file contents.
+    std::vector<uint8_t> save() const;
+    uint32_t id() const;   // 0 if nothing is loaded
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+    friend class HuffzipCompressor;
+    friend class HuffzipDecompressor;
+};
+
+struct HuffzipOptions {
+    bool huffman_only = false;   // skip LZ77, code bytes directly
+    int level = 6;               // LZ77 level, 1 (fastest) .. 9 (best)
+    int window = 1 << 20;        // LZ77 window, up to 16 MiB
+    size_t block_size = 0;       // largest block; 0: 1 MiB, or the window if larger
+    const HuffzipDictionary* dictionary = nullptr;
+};
+
+class HuffzipCompressor {
+public:
+    explicit HuffzipCompressor(const HuffzipOptions& options = HuffzipOptions());
+    ~HuffzipCompressor();
+    HuffzipCompressor(HuffzipCompressor&&) noexcept;
+    HuffzipCompressor& operator=(HuffzipCompressor&&) noexcept;
+
+    // Start a new stream, optionally with new options.  Keeps the memory.
+    void reset();
+    bool reset(const HuffzipOptions& options);
+
+    bool write(const void* data, size_t size, std::vector<uint8_t>& out);
+    bool finish(std::vector<uint8_t>& out);
+    const char* error() const;   // nullptr if no error
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
+
+class HuffzipDecompressor {
+public:
+    HuffzipDecompressor();
+    ~HuffzipDecompressor();
+    HuffzipDecompressor(HuffzipDecompressor&&) noexcept;
+    HuffzipDecompressor& operator=(HuffzipDecompressor&&) noexcept;
+
+    void reset();
+    // Make a dictionary available to the streams that name its id.
+    void add_dictionary(const HuffzipDictionary& dictionary);
+
+    bool write(const void* data, size_t size, std::vector<uint8_t>& out);
+    bool finish(std::vector<uint8_t>& out);
+    const char* error() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
+
+// Compress or decompress a whole buffer with a context, replacing the
+// contents of `dst` (its capacity is reused).  The context is reset first.
+bool huffzip_compress(HuffzipCompressor& ctx, const void* src, size_t size, std::vector<uint8_t>& dst);
+bool huffzip_decompress(HuffzipDecompressor& ctx, const void* src, size_t size, std::vector<uint8_t>& dst);
@@ -0,0 +1,114 @@
+#include <bits/stdc++.h>
+#include "kernels.h"
+#ifdef HUFFZIP_SIMD_COMPARE
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+static inline int _ctz64(uint64_t v) {
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward64(&i, v);
+    return (int)i;
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+
+static inline int _ctz32(uint32_t v) {
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward(&i, v);
+    return (int)i;
+#else
+    return __builtin_ctz(v);
+#endif
+}
+
+void _histogram_scalar(const uint8_t* data, size_t size, uint32_t* counts) {
+    for (size_t i = 0; i < size; i++) counts[data[i]]++;
+}
+
+void histogram(const uint8_t* data, size_t size, uint32_t* counts) {
+    uint32_t t[4][256] = {};
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t w;
+        memcpy(&w, data + i, 8);
+        t[0][w & 0xFF]++;
+        t[1][(w >> 8) & 0xFF]++;
+        t[2][(w >> 16) & 0xFF]++;
+        t[3][(w >> 24) & 0xFF]++;
+        t[0][(w >> 32) & 0xFF]++;
+        t[1][(w >> 40) & 0xFF]++;
+        t[2][(w >> 48) & 0xFF]++;
+        t[3][w >> 56]++;
+    }
+    for (; i < size; i++) t[0][data[i]]++;
+    for (int s = 0; s < 256; s++) counts[s] += t[0][s] + t[1][s] + t[2][s] + t[3][s];
+}
+
+int _match_length_bytes(const uint8_t* a, const uint8_t* b, int limit) {
+    int len = 0;
+    while (len < limit && a[len] == b[len]) len++;
+    return len;
+}
+
+// Eight bytes per step; the lowest differing byte is the first one on a
+// little-endian host.
+int _match_length_word(const uint8_t* a, const uint8_t* b, int limit) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return _match_length_bytes(a, b, limit);
+#else
+    int len = 0;
+    while (len + 8 <= limit) {
+        uint64_t x, y;
+        memcpy(&x, a + len, 8);
+        memcpy(&y, b + len, 8);
+        if (x != y) return len + (_ctz64(x ^ y) >> 3);
+        len += 8;
+    }
+    return len + _match_length_bytes(a + len, b + len, limit - len);
+#endif
+}
+
+#ifdef HUFFZIP_SIMD_COMPARE
+#ifdef __GNUC__
+__attribute__((target("sse2")))
+#endif
+int _match_length_sse2(const uint8_t* a, const uint8_t* b, int limit) {
+    int len = 0;
+    while (len + 16 <= limit) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(a + len));
+        __m128i y = _mm_loadu_si128((const __m128i*)(b + len));
+        uint32_t diff = ~(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) & 0xFFFF;
+        if (diff) return len + _ctz32(diff);
+        len += 16;
+    }
+    return len + _match_length_word(a + len, b + len, limit - len);
+}
+
+#ifdef __GNUC__
+__attribute__((target("avx2")))
+#endif
+int _match_length_avx2(const uint8_t* a, const uint8_t* b, int limit) {
+    int len = 0;
+    while (len + 32 <= limit) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + len));
+        __m256i y = _mm256_loadu_si256((const __m256i*)(b + len));
+        uint32_t diff = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y));
+        if (diff) return len + _ctz32(diff);
+        len += 32;
+    }
+    return len + _match_length_sse2(a + len, b + len, limit - len);
+}
+#endif
+
+MatchLengthFn _select_match_length() {
+#ifdef HUFFZIP_SIMD_COMPARE
+    if (cpu_features().avx2) return _match_length_avx2;
+    if (cpu_features().sse2) return _match_length_sse2;
+#endif
+    return _match_length_word;
+}
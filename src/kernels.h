@@ -0,0 +1,44 @@
+/*
+Small data-parallel kernels shared by the encoder.
+
+histogram(data, size, counts): adds the byte counts of `data` to counts[256].
+    A single counter table stalls whenever the same byte repeats: each
+    increment waits for the previous store to the same counter.  Four tables,
+    indexed by byte position mod 4, keep neighbouring bytes on separate
+    counters; they are summed at the end.
+match_length(a, b, limit): number of equal leading bytes of a and b, at most
+    `limit`.  Compares 8 (portable), 16 (SSE2) or 32 (AVX2) bytes at a time
+    and finds the first difference with a count of trailing zeros.  The widest
+    engine the CPU supports is picked at runtime.  Never reads past `limit`.
+
+The byte-at-a-time versions are kept as the reference for the kernel tests.
+*/
+
+#pragma once
+#include <bits/stdc++.h>
+#include "cpu.h"
+#if defined(HUFFZIP_X86) && (defined(__GNUC__) || defined(_MSC_VER))
+#define HUFFZIP_SIMD_COMPARE 1
+#endif
+
+using namespace std;
+
+void histogram(const uint8_t* data, size_t size, uint32_t* counts);
+
+using MatchLengthFn = int (*)(const uint8_t*, const uint8_t*, int);
+
+MatchLengthFn _select_match_length();
+
+inline int match_length(const uint8_t* a, const uint8_t* b, int limit) {
+    static const MatchLengthFn impl = _select_match_length();
+    return impl(a, b, limit);
+}
+
+// The engines and the byte-at-a-time references, for the kernel tests.
+void _histogram_scalar(const uint8_t* data, size_t size, uint32_t* counts);
+int _match_length_bytes(const uint8_t* a, const uint8_t* b, int limit);
+int _match_length_word(const uint8_t* a, const uint8_t* b, int limit);
+#ifdef HUFFZIP_SIMD_COMPARE
+int _match_length_sse2(const uint8_t* a, const uint8_t* b, int limit);
+int _match_length_avx2(const uint8_t* a, const uint8_t* b, int limit);
+#endif
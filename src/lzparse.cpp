@@ -0,0 +1,170 @@
+#include <bits/stdc++.h>
+#include "lzparse.h"
+
+using namespace std;
+
+// A minimum-length match farther than this costs more than three literals.
+const int TOO_FAR = 4096;
+
+static Match _usable(Match m) {
+    if (m.length < MIN_MATCH || (m.length == MIN_MATCH && m.distance > TOO_FAR)) return { 0, 0 };
+    return m;
+}
+
+// Greedy (lookahead 0) and lazy parses of data[start, size) into `tokens`.
+// look[k] is the match found at i + k, for k < have.
+static void _lz77_lazy(const uint8_t* data, size_t size, size_t start, MatchFinder& mf, int lookahead,
+    vector<LZToken>& tokens) {
+    tokens.clear();
+    int max_lazy = mf.config().max_lazy;
+    Match look[3];
+    int have = 0;
+    size_t i = start;
+    while (i < size) {
+        if (have == 0) {
+            look[0] = _usable(mf.find(i));
+            have = 1;
+        }
+        Match m = look[0];
+        int defer = m.length == 0 ? 1 : 0;
+        for (int k = 1; !defer && k <= lookahead && m.length < max_lazy && i + k < size; k++) {
+            if (have <= k) {
+                look[k] = _usable(mf.find(i + k, m.length + k - 1));
+                have = k + 1;
+            }
+            // A later match must make up for the k literals in front of it.
+            if (look[k].length > m.length + k - 1) defer = k;
+        }
+        if (defer) {
+            for (int k = 0; k < defer; k++) tokens.push_back({ true, (char)data[i + k], 0, 0 });
+            i += defer;
+            have -= defer;
+            for (int k = 0; k < have; k++) look[k] = look[k + defer];
+            continue;
+        }
+        tokens.push_back({ false, 0, m.distance, m.length });
+        for (size_t p = i + have; p < i + m.length; p++) mf.skip(p, m.length);
+        i += m.length;
+        have = 0;
+    }
+}
+
+// Bits per symbol under the Huffman code for `freq`.  Symbols that are not
+// used yet are priced as the longest code.
+static void _symbol_prices(const uint32_t* freq, int n, uint32_t* price) {
+    uint8_t lengths[MAX_ALPHABET];
+    huffman_code_lengths(freq, n, MAX_CODE_LEN, lengths);
+    for (int s = 0; s < n; s++) price[s] = lengths[s] > 0 ? lengths[s] : MAX_CODE_LEN;
+}
+
+const vector<LZToken>& LZParser::parse(const uint8_t* data, size_t size, int level,
+    int window, int max_length, size_t prefix) {
+    level = min(max(level, 1), 9);
+    ParseMode mode = LEVELS[level].parse;
+    if (mode == PARSE_OPTIMAL) optimal(data, size, prefix, level, window, max_length);
+    else {
+        start(data, size, prefix, level, window, max_length);
+        _lz77_lazy(data, size, prefix, mf, mode == PARSE_LAZY2 ? 2 : mode == PARSE_LAZY1 ? 1 : 0, tokens);
+    }
+    return tokens;
+}
+
+void LZParser::start(const uint8_t* data, size_t size, size_t prefix, int level, int window, int max_length) {
+    size_t capacity = max(2 * prefix, (size_t)1 << 16);
+    if (prefix == 0 || size > capacity) {
+        mf.reset(data, size, window, max_length, level);
+        for (size_t p = 0; p < prefix; p++) mf.skip(p);
+        return;
+    }
+    if (primed_dict.size() != prefix || primed_capacity != capacity || primed_level != level
+        || primed_window != window || primed_max_length != max_length
+        || memcmp(primed_dict.data(), data, prefix) != 0) {
+        primed_dict.assign(data, data + prefix);
+        primed_capacity = capacity;
+        primed_level = level;
+        primed_window = window;
+        primed_max_length = max_length;
+        primed.prime(primed_dict.data(), prefix, capacity, window, max_length, level);
+    }
+    mf.resume(primed, data, size);
+}
+
+void LZParser::optimal(const uint8_t* data, size_t size, size_t prefix, int level, int window, int max_length) {
+    uint32_t freq[NUM_SYMBOLS] = {}, dist_freq[NUM_DIST_SYMBOLS] = {};
+    start(data, size, prefix, level, window, max_length);
+    _lz77_lazy(data, size, prefix, mf, 2, tokens);
+    for (const LZToken& t : tokens) {
+        if (t.is_literal) freq[(unsigned char)t.literal]++;
+        else {
+            freq[256 + length_code(t.length)]++;
+            dist_freq[dist_code(t.distance)]++;
+        }
+    }
+    uint32_t price[NUM_SYMBOLS], dist_price[NUM_DIST_SYMBOLS];
+    _symbol_prices(freq, NUM_SYMBOLS, price);
+    _symbol_prices(dist_freq, NUM_DIST_SYMBOLS, dist_price);
+    auto match_price = [&](int length, uint32_t dist_bits) {
+        int lc = length_code(length);
+        return price[256 + lc] + LENGTH_CODES[lc].extra + dist_bits;
+    };
+    auto dist_bits = [&](int distance) {
+        int dc = dist_code(distance);
+        return dist_price[dc] + DIST_CODES[dc].extra;
+    };
+
+    cost.assign(size + 1, UINT32_MAX);
+    step_len.assign(size + 1, 0);
+    step_dist.assign(size + 1, 0);
+    cost[prefix] = 0;
+    auto relax = [&](size_t to, uint32_t c, int length, int distance) {
+        if (c < cost[to]) {
+            cost[to] = c;
+            step_len[to] = length;
+            step_dist[to] = distance;
+        }
+    };
+
+    start(data, size, prefix, level, window, max_length);
+    int nice = mf.config().nice_length;
+    size_t covered_end = 0;   // end of the last long match taken as is
+    int covered_len = 0;
+    for (size_t i = prefix; i < size; i++) {
+        uint32_t c = cost[i];
+        relax(i + 1, c + price[data[i]], 1, 0);
+        if (i < covered_end) {
+            mf.skip(i, covered_len);
+            continue;
+        }
+        const vector<Match>& matches = mf.find_all(i);
+        if (matches.empty()) continue;
+        const Match& longest = matches.back();
+        if (longest.length >= nice) {
+            relax(i + longest.length, c + match_price(longest.length, dist_bits(longest.distance)),
+                longest.length, longest.distance);
+            covered_end = i + longest.length;
+            covered_len = longest.length;
+            continue;
+        }
+        // Each reported match serves the lengths above the previous one.
+        int length = MIN_MATCH;
+        for (const Match& m : matches) {
+            uint32_t db = dist_bits(m.distance);
+            for (; length <= m.length; length++)
+                relax(i + length, c + match_price(length, db), length, m.distance);
+        }
+    }
+
+    tokens.clear();
+    for (size_t p = size; p > prefix; p -= step_len[p]) {
+        if (step_dist[p] == 0) tokens.push_back({ true, (char)data[p - 1], 0, 0 });
+        else tokens.push_back({ false, 0, (int)step_dist[p], (int)step_len[p] });
+    }
+    reverse(tokens.begin(), tokens.end());
+}
+
+// One-shot form of LZParser::parse.
+vector<LZToken> lz77_compress(const uint8_t* data, size_t size, int level,
+    int window_size, int max_length) {
+    LZParser parser;
+    return parser.parse(data, size, level, window_size, max_length);
+}
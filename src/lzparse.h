@@ -0,0 +1,63 @@
+/*
+LZ77 parsing: turns the matches reported by MatchFinder into the LZToken
+stream that the block coder entropy codes.  The ParseMode of the level picks
+the strategy:
+
+Greedy   take the longest match at each position.
+Lazy     before taking a match shorter than max_lazy, look one (LAZY1) or
+         two (LAZY2) positions ahead; if a match starting there is longer by
+         more than the literals that would precede it, emit those literals
+         instead.
+Optimal  a shortest-path search over the block.  A lazy parse of the block
+         gives symbol frequencies, and their Huffman code lengths become the
+         price in bits of every literal, length and distance.  Each position
+         then relaxes the cost of the positions its literal and every match
+         length from find_all() lead to, and the cheapest path, followed
+         back from the end, is the token stream.  A match of nice_length or
+         more is the only match tried from its start, and the positions it
+         covers are not searched, so long runs stay linear.
+*/
+
+#pragma once
+#include <bits/stdc++.h>
+#include "huffman.h"
+
+using namespace std;
+
+// Parser state kept between blocks: the match finder tables, the token
+// buffer and the optimal parser's arrays are reused, so parsing blocks of
+// one size allocates nothing after the first.
+class LZParser {
+public:
+    // Tokenize `data` with the parse strategy and search effort of `level`
+    // (1-9), see LEVELS in matchfinder.h.  Valid until the next call.
+    // data[0, prefix) is history (a dictionary): it is indexed so matches can
+    // reach into it, and only data[prefix, size) is tokenized.
+    const vector<LZToken>& parse(const uint8_t* data, size_t size, int level = DEFAULT_LEVEL,
+        int window = DEFAULT_WINDOW, int max_length = MAX_MATCH, size_t prefix = 0);
+
+private:
+    MatchFinder mf;
+    vector<LZToken> tokens;
+    // cost[p]: fewest bits for data[prefix, p); step_len / step_dist[p]: the last
+    // token on that path (distance 0 for a literal).
+    vector<uint32_t> cost, step_len, step_dist;
+
+    // A match finder with the last dictionary indexed, for inputs of up to
+    // primed_capacity bytes; see start().
+    MatchFinder primed;
+    vector<uint8_t> primed_dict;
+    size_t primed_capacity = 0;
+    int primed_level = 0, primed_window = 0, primed_max_length = 0;
+
+    // Reset the match finder for data[0, size) with data[0, prefix) indexed.
+    // Small inputs after a dictionary start from a copy of the primed
+    // finder rather than indexing the dictionary every time.
+    void start(const uint8_t* data, size_t size, size_t prefix, int level, int window, int max_length);
+
+    void optimal(const uint8_t* data, size_t size, size_t prefix, int level, int window, int max_length);
+};
+
+// One-shot form of LZParser::parse.
+vector<LZToken> lz77_compress(const uint8_t* data, size_t size, int level = DEFAULT_LEVEL,
+    int window_size = DEFAULT_WINDOW, int max_length = MAX_MATCH);
@@ -2,317 +2,376 @@
 A program that performs huffman encoding on input.
 Command line arguments
 
--u, --unzip:   Unzip the file. (default: false, meaning zip the file)
--v, --verbose: Print verbose output, including entropy, average length and comparison with those metrics for shannon and shannon-fano encoding. (default: false)
---huffman:     Pure Huffman encoding. (default: false, LZ77 encoding is used by default)
+-u, --unzip:        Unzip the file. (default: false, meaning zip the file)
+-v, --verbose:      Print verbose output, including entropy, average length and comparison with those metrics for shannon and shannon-fano encoding. (default: false)
+--huffman:          Pure Huffman encoding. (default: false, LZ77 encoding is used by default)
+-1 .. -9:           LZ77 compression level, fastest to best. (default: 6)
+--block-size <n>:   Largest block, with an optional K or M suffix; smaller ones are cut where the data changes. (default: 1M, or the window if larger)
+--window <n>:       LZ77 window, up to 16M; matches never reach outside their block. (default: 1M)
+-j <n>:             Code blocks on n worker threads, 0 = one per core. (default: 1)
+--range <off>:<len>: With -u, extract only bytes [off, off + len) of the original data.
+--bench [files]:    Time compression and decompression stage by stage, in memory on one thread, over the
+                    given files or a generated corpus.  Takes the level, mode, block size and --dict options.
+--runs <n>:         With --bench, runs per file; the fastest is reported. (default: 3)
+--json <file>:      With --bench, also write the results as JSON ("-" for stdout).
+--train <dict>:     Train a dictionary for small inputs on the sample files that follow and write it to <dict>.
+--dict-size <n>:    With --train, bytes of dictionary content. (default: 32K)
+--dict-id <n>:      With --train, the id compressed files use to name the dictionary. (default: derived from it)
+--dict <file>:      Compress with this dictionary; when decompressing, may be given several times and the
+                    one the file names is used.
+
+Input and output may be "-" for stdin / stdout.
 */
 
 #include <bits/stdc++.h>
-#include "huffman.cpp"
-#include "shannon.cpp"
+#include "bench.h"
+#include "container.h"
+#include "shannon.h"
 
 using namespace std;
 
-uint32_t crc32(const string& data) {
-    // cursed reflected polynomial implementation
-    uint32_t crc = 0xFFFFFFFF;
-    for (char c : data) {
-        crc ^= (uint8_t)c;
-        for (int i = 0; i < 8; i++) {
-            if (crc & 1) crc = (crc >> 1) ^ 0xEDB88320;
-            else crc >>= 1;
-        }
-    }
-    return ~crc;
+// Parse a size such as "65536", "64K" or "4M".
+static bool parse_size(const string& s, uint64_t& out) {
+    char* end = nullptr;
+    unsigned long long v = strtoull(s.c_str(), &end, 10);
+    if (end == s.c_str()) return false;
+    string suffix = end;
+    if (suffix == "K" || suffix == "k") v <<= 10;
+    else if (suffix == "M" || suffix == "m") v <<= 20;
+    else if (suffix == "G" || suffix == "g") v <<= 30;
+    else if (!suffix.empty()) return false;
+    out = v;
+    return true;
 }
 
-int main(int argc, char* argv[]) {
-    bool unzip = false;
-    bool verbose = false;
-    bool huffman_only = false; // default LZ77
+// Parse "<offset>:<length>"; both parts accept size suffixes.
+static bool parse_range(const string& s, uint64_t& offset, uint64_t& length) {
+    size_t colon = s.find(':');
+    if (colon == string::npos) return false;
+    return parse_size(s.substr(0, colon), offset) && parse_size(s.substr(colon + 1), length);
+}
 
-    for (int i = 1; i < argc; i++) {
-        string arg = argv[i];
-        if (arg == "-u" || arg == "--unzip") unzip = true;
-        else if (arg == "-v" || arg == "--verbose") verbose = true;
-        else if (arg == "--huffman") huffman_only = true;
+static bool read_whole_file(const string& name, vector<uint8_t>& data) {
+    InputFile in;
+    if (!in.open(name)) return false;
+    data.clear();
+    for (;;) {
+        Chunk c = in.take(IO_BUFFER_SIZE);
+        if (c.size == 0) break;
+        data.insert(data.end(), c.data, c.data + c.size);
     }
+    return !in.failed();
+}
 
-    if (argc < 3) {
-        printf("Usage: %s [options] input output\n", argv[0]);
-        return 1;
+static bool load_dictionary(const string& name, Dictionary& dict) {
+    vector<uint8_t> data;
+    if (!read_whole_file(name, data)) {
+        fprintf(stderr, "Cannot open dictionary %s\n", name.c_str());
+        return false;
     }
+    if (!dict.parse(data.data(), data.size())) {
+        fprintf(stderr, "Invalid dictionary: %s\n", name.c_str());
+        return false;
+    }
+    return true;
+}
 
-    string input_file = argv[argc - 2];
-    string output_file = argv[argc - 1];
-
-    if (unzip) {
-        // Decompress
-        ifstream in(input_file, ios::binary); // open file in binary mode
-        if (!in) {
-            printf("Cannot open input file\n");
-            return 1;
-        }
-
-        uint32_t sig;
-        in.read((char*)&sig, 4);
-        if (sig != 0x1518C234) {
-            printf("Invalid file signature\n");
+// --train: every file is one sample.
+static int train(const string& dict_file, const vector<string>& sample_files, size_t dict_size, int level,
+    uint32_t id) {
+    vector<vector<uint8_t>> samples(sample_files.size());
+    size_t total = 0;
+    for (size_t i = 0; i < sample_files.size(); i++) {
+        if (!read_whole_file(sample_files[i], samples[i])) {
+            fprintf(stderr, "Cannot open sample %s\n", sample_files[i].c_str());
             return 1;
         }
+        total += samples[i].size();
+    }
+    Dictionary dict = train_dictionary(samples, dict_size, level, id);
+    vector<uint8_t> bytes = dict.serialize();
+    OutputFile out;
+    if (!out.open(dict_file)) {
+        fprintf(stderr, "Cannot open output file\n");
+        return 1;
+    }
+    out.write(bytes.data(), bytes.size());
+    if (!out.close()) {
+        fprintf(stderr, "Cannot write output file\n");
+        return 1;
+    }
+    printf("Dictionary %08x: %zu bytes of content from %zu samples (%zu bytes)\n", dict.id, dict.content.size(),
+        samples.size(), total);
+    return 0;
+}
 
-        uint8_t flag;
-        in.read((char*)&flag, 1);
-        uint8_t dontcare;
-        in.read((char*)&dontcare, 1);
-        uint32_t crc_stored;
-        in.read((char*)&crc_stored, 4);
-        uint32_t comp_size;
-        in.read((char*)&comp_size, 4);
-        uint32_t uncomp_size;
-        in.read((char*)&uncomp_size, 4);
-
-        vector<int> freq(288, 0);
-        for (int i = 0; i < 288; i++) {
-            in.read((char*)&freq[i], 4);
-        }
-
-        Node* root = generate_tree(freq);
-
-        vector<uint8_t> data_packed;
-        uint8_t b;
-        while (in.read((char*)&b, 1)) {
-            data_packed.push_back(b);
+// -v output for compression.  Shannon / Shannon-Fano / Huffman are all
+// applied to the raw source bytes so the three schemes are compared fairly;
+// the actual figures come from the per-block coding statistics.
+static void print_stats(FILE* log, const vector<long long>& source_freq, uint64_t source_size,
+    const BlockStats& stats, uint64_t comp_size, bool huffman_only) {
+    vector<int> byte_freq(source_freq.begin(), source_freq.end());
+
+    // --- Source entropy (bits per source symbol) ---
+    double entropy = 0.0;
+    for (int i = 0; i < 256; i++) {
+        if (byte_freq[i] > 0) {
+            double p = (double)byte_freq[i] / source_size;
+            entropy -= p * log2(p);
         }
+    }
 
-        string binary;
-        for (uint8_t byte : data_packed) {
-            for (int i = 7; i >= 0; i--) {
-                int bit = (byte >> i) & 1;
-                binary += '0' + bit;
-            }
+    // --- Huffman on source bytes ---
+    vector<int> huff_lengths = tree_code_lengths(byte_freq);
+    int unique_symbols = 0;
+    double huff_avg = 0.0;
+    for (int i = 0; i < 256; i++) {
+        if (byte_freq[i] > 0) {
+            double p = (double)byte_freq[i] / source_size;
+            huff_avg += p * huff_lengths[i];
+            unique_symbols++;
         }
+    }
+    double huff_eff = (huff_avg > 0.0) ? entropy / huff_avg : 0.0;
+
+    // --- Shannon coding on source bytes ---
+    ShannonResult sr = shannon_coding(byte_freq);
+
+    // --- Shannon-Fano coding on source bytes ---
+    ShannonResult sfr = shannon_fano_coding(byte_freq);
+
+    // --- N-ary Huffman examples (ternary + quaternary) ---
+    map<int, string> huff3_codes, huff4_codes;
+    NaryNode* huff3_root = generate_tree_nary(byte_freq, 3);
+    NaryNode* huff4_root = generate_tree_nary(byte_freq, 4);
+    build_codes_nary(huff3_root, huff3_codes);
+    build_codes_nary(huff4_root, huff4_codes);
+    double huff3_avg = avg_code_length(byte_freq, huff3_codes);
+    double huff4_avg = avg_code_length(byte_freq, huff4_codes);
+    // Efficiency: for base-n Huffman, optimal avg length is H / log2(n)
+    double huff3_eff = (huff3_avg > 0.0) ? (entropy / log2(3)) / huff3_avg : 0.0;
+    double huff4_eff = (huff4_avg > 0.0) ? (entropy / log2(4)) / huff4_avg : 0.0;
+    free_tree_nary(huff3_root);
+    free_tree_nary(huff4_root);
+
+    // --- Actual compressed stats (whatever mode was used) ---
+    long long token_total = 0;
+    for (int i = 0; i < NUM_SYMBOLS; i++) token_total += stats.freq[i];
+    double actual_avg = token_total > 0 ? (double)stats.coded_bits / token_total : 0.0;
+
+    // --- Cost of the code length limit ---
+    double limit_loss = stats.unbounded_bits > 0
+        ? (double)(stats.coded_bits - stats.unbounded_bits) / stats.unbounded_bits : 0.0;
+
+    // -------------------------------------------------------
+    // Pretty-print using printf to avoid MinGW cout-flush bugs
+    // -------------------------------------------------------
+#define SEP "----------------------------------------------------\n"
 
-        string decoded;
-        if (flag == 0) {
-            decoded = decode_huffman(root, binary);
-            decoded = decoded.substr(0, uncomp_size);
-        }
-        else {
-            vector<LZToken> tokens = decode_lz_huffman(root, binary);
-            decoded = lz77_decompress(tokens);
-            decoded = decoded.substr(0, uncomp_size);
-        }
+    fprintf(log, SEP);
+    fprintf(log, "  Source statistics\n");
+    fprintf(log, SEP);
+    fprintf(log, "  Symbols (unique / total)  : %d / %llu\n",
+        unique_symbols, (unsigned long long)source_size);
+    fprintf(log, "  Shannon entropy           : %.4f bits/symbol\n", entropy);
+    fprintf(log, SEP);
+    fprintf(log, "  Coding scheme comparison (source bytes)\n");
+    fprintf(log, SEP);
+    fprintf(log, "  %-20s  %8s  %10s\n", "Scheme", "Avg len", "Efficiency");
+    fprintf(log, SEP);
+    fprintf(log, "  %-20s  %8.4f  %9.4f%%\n",
+        "Shannon", sr.avg_code_length, sr.efficiency * 100);
+    fprintf(log, "  %-20s  %8.4f  %9.4f%%\n",
+        "Shannon-Fano", sfr.avg_code_length, sfr.efficiency * 100);
+    fprintf(log, "  %-20s  %8.4f  %9.4f%%\n",
+        "Huffman (binary)", huff_avg, huff_eff * 100);
+    fprintf(log, "  %-20s  %8.4f  %9.4f%%  (base-3 symbols)\n",
+        "Huffman (ternary)", huff3_avg, huff3_eff * 100);
+    fprintf(log, "  %-20s  %8.4f  %9.4f%%  (base-4 symbols)\n",
+        "Huffman (quaternary)", huff4_avg, huff4_eff * 100);
+    fprintf(log, SEP);
+    fprintf(log, "  Actual compression\n");
+    fprintf(log, SEP);
+    fprintf(log, "  Mode                      : %s\n",
+        huffman_only ? "Huffman-only" : "LZ77 + Huffman");
+    fprintf(log, "  Blocks                    : %lld (%lld LZ77, %lld Huffman-only, %lld stored)\n",
+        stats.lz_blocks + stats.huffman_blocks + stats.stored_blocks, stats.lz_blocks, stats.huffman_blocks,
+        stats.stored_blocks);
+    if (stats.fse_blocks)
+        fprintf(log, "  tANS-coded blocks         : %lld (symbols in %.2f%% fewer bits than Huffman)\n",
+            stats.fse_blocks, 100.0 * (1.0 - (double)stats.fse_bits / max<uint64_t>(stats.fse_huffman_bits, 1)));
+    fprintf(log, "  Avg token code length     : %.4f bits\n", actual_avg);
+    if (!huffman_only)
+        fprintf(log, "  Avg match distance cost   : %.4f bits (%lld matches)\n",
+            stats.matches > 0 ? (double)stats.dist_bits / stats.matches : 0.0, stats.matches);
+    fprintf(log, "  Max code length           : %d bits (unbounded: %d, limit: %d)\n",
+        stats.max_len, stats.unbounded_max_len, MAX_CODE_LEN);
+    fprintf(log, "  Length-limit loss         : %.4f%% (%llu extra bits)\n",
+        limit_loss * 100, (unsigned long long)(stats.coded_bits - stats.unbounded_bits));
+    fprintf(log, "  Compressed size           : %llu bytes\n", (unsigned long long)comp_size);
+    fprintf(log, "  Uncompressed size         : %llu bytes\n", (unsigned long long)source_size);
+    fprintf(log, "  Compression ratio         : %.4f\n",
+        (double)comp_size / source_size);
+    fprintf(log, SEP);
+    fflush(log);
 
-        uint32_t computed_crc = crc32(decoded);
-        if (computed_crc != crc_stored) {
-            printf("CRC mismatch\n");
-            return 1;
-        }
+#undef SEP
+}
 
-        ofstream out(output_file, ios::binary);
-        out.write(decoded.c_str(), decoded.size());
+int main(int argc, char* argv[]) {
+    bool unzip = false;
+    bool verbose = false;
+    StreamOptions opt;
+    bool range = false;
+    uint64_t range_offset = 0, range_length = 0;
+    bool block_size_set = false;
+    bool bench = false;
+    int bench_runs = 3;
+    string json_path;
+    string train_file;
+    size_t dict_size = DEFAULT_DICT_SIZE;
+    uint32_t dict_id = 0;
+    vector<string> dict_files;
+    vector<string> files;
 
-        if (verbose) {
-            printf("Decompressed successfully\n");
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "-u" || arg == "--unzip") unzip = true;
+        else if (arg == "-v" || arg == "--verbose") verbose = true;
+        else if (arg == "--huffman") opt.huffman_only = true;
+        else if (arg == "--bench") bench = true;
+        else if (arg == "--runs" && i + 1 < argc) {
+            bench_runs = atoi(argv[++i]);
+            if (bench_runs < 1) {
+                fprintf(stderr, "Invalid run count: %s\n", argv[i]);
+                return 1;
+            }
         }
-    }
-    else {
-        // Compress
-        ifstream in(input_file, ios::binary);
-        if (!in) {
-            printf("Cannot open input file\n");
-            return 1;
+        else if (arg == "--json" && i + 1 < argc) json_path = argv[++i];
+        else if (arg == "--train" && i + 1 < argc) train_file = argv[++i];
+        else if (arg == "--dict" && i + 1 < argc) dict_files.push_back(argv[++i]);
+        else if (arg == "--dict-size" && i + 1 < argc) {
+            uint64_t size;
+            if (!parse_size(argv[++i], size) || size == 0 || size > MAX_DICT_SIZE) {
+                fprintf(stderr, "Invalid dictionary size: %s\n", argv[i]);
+                return 1;
+            }
+            dict_size = (size_t)size;
         }
-
-        string text((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
-        vector<int> freq(288, 0);
-
-        vector<LZToken> tokens;
-        if (!huffman_only) {
-            tokens = lz77_compress(text);
-            for (auto& t : tokens) {
-                if (t.is_literal) freq[(unsigned char)t.literal]++;
-                else {
-                    int len_code = t.length - 3;
-                    if (len_code >= 0 && len_code < 32) freq[256 + len_code]++;
-                }
+        else if (arg == "--dict-id" && i + 1 < argc) {
+            uint64_t id;
+            if (!parse_size(argv[++i], id) || id == 0 || id > UINT32_MAX) {
+                fprintf(stderr, "Invalid dictionary id: %s\n", argv[i]);
+                return 1;
             }
+            dict_id = (uint32_t)id;
         }
-        else {
-            for (unsigned char c : text) freq[c]++;
+        else if (arg.size() == 2 && arg[0] == '-' && arg[1] >= '1' && arg[1] <= '9') opt.level = arg[1] - '0';
+        else if (arg == "--block-size" && i + 1 < argc) {
+            uint64_t size;
+            if (!parse_size(argv[++i], size) || size == 0 || size > MAX_BLOCK_SIZE) {
+                fprintf(stderr, "Invalid block size: %s\n", argv[i]);
+                return 1;
+            }
+            opt.block_size = (size_t)size;
+            block_size_set = true;
         }
-
-        Node* root = generate_tree(freq);
-        map<int, string> codes;
-        build_codes(root, codes);
-
-        string encoded;
-        if (huffman_only) {
-            for (unsigned char c : text) {
-                encoded += codes[c];
+        else if (arg == "--window" && i + 1 < argc) {
+            uint64_t size;
+            if (!parse_size(argv[++i], size) || size == 0 || size > MAX_WINDOW) {
+                fprintf(stderr, "Invalid window size: %s\n", argv[i]);
+                return 1;
             }
+            opt.window = (int)size;
         }
-        else {
-            for (auto& t : tokens) {
-                if (t.is_literal) {
-                    encoded += codes[(unsigned char)t.literal];
-                }
-                else {
-                    int sym = 256 + (t.length - 3);
-                    encoded += codes[sym];
-                    for (int i = 23; i >= 0; i--) {
-                        encoded += '0' + ((t.distance >> i) & 1);
-                    }
-                }
+        else if (arg == "--range" && i + 1 < argc) {
+            if (!parse_range(argv[++i], range_offset, range_length)) {
+                fprintf(stderr, "Invalid range: %s\n", argv[i]);
+                return 1;
             }
+            range = true;
         }
-        // Pack encoded to bytes
-        vector<uint8_t> data_packed;
-        int bitpos = 0;
-        uint8_t byte = 0;
-        for (char b : encoded) {
-            byte |= (b - '0') << (7 - bitpos);
-            bitpos++;
-            if (bitpos == 8) {
-                data_packed.push_back(byte);
-                byte = 0;
-                bitpos = 0;
+        else if (arg.rfind("-j", 0) == 0) {
+            string n = arg.size() > 2 ? arg.substr(2) : (i + 1 < argc ? argv[++i] : "");
+            if (n.empty() || n.find_first_not_of("0123456789") != string::npos) {
+                fprintf(stderr, "Invalid thread count: %s\n", n.c_str());
+                return 1;
             }
+            opt.jobs = atoi(n.c_str());
         }
-        if (bitpos > 0) data_packed.push_back(byte);
-
-        ofstream out(output_file, ios::binary);
-        if (!out) {
-            printf("Cannot open output file\n");
+        else if (arg.size() > 1 && arg[0] == '-') {
+            fprintf(stderr, "Unknown option: %s\n", arg.c_str());
             return 1;
         }
+        else files.push_back(arg);
+    }
 
-        uint32_t sig = 0x1518C234;
-        out.write((char*)&sig, 4);
-        uint8_t flag = huffman_only ? 0 : 1;
-        out.write((char*)&flag, 1);
-        uint8_t dontcare = 0;
-        out.write((char*)&dontcare, 1);
-        uint32_t crc = crc32(text);
-        out.write((char*)&crc, 4);
-        uint32_t comp_size = 4 + 1 + 1 + 4 + 4 + 4 + 288 * 4 + data_packed.size();
-        out.write((char*)&comp_size, 4);
-        uint32_t uncomp_size_val = text.size();
-        out.write((char*)&uncomp_size_val, 4);
-
-        for (int f : freq) {
-            out.write((char*)&f, 4);
+    // Blocks are independent, so a window only pays off inside a block at
+    // least as large.
+    if (!block_size_set) opt.block_size = max(opt.block_size, (size_t)opt.window);
+
+    if (!train_file.empty()) {
+        if (unzip || range || bench || files.empty()) {
+            printf("Usage: %s --train dictionary [--dict-size n] [--dict-id n] [-1 .. -9] samples...\n", argv[0]);
+            return 1;
         }
+        return train(train_file, files, dict_size, opt.level, dict_id);
+    }
 
-        for (auto b : data_packed) {
-            out.write((char*)&b, 1);
+    vector<Dictionary> dicts(dict_files.size());
+    for (size_t i = 0; i < dict_files.size(); i++)
+        if (!load_dictionary(dict_files[i], dicts[i])) return 1;
+    if (!unzip && dicts.size() > 1) {
+        fprintf(stderr, "Compression takes one --dict\n");
+        return 1;
+    }
+    if (!unzip && !dicts.empty()) opt.dict = &dicts[0];
+
+    if (bench) {
+        if (unzip || range) {
+            fprintf(stderr, "--bench cannot be combined with -u or --range\n");
+            return 1;
         }
+        return run_bench(files, opt, bench_runs, json_path);
+    }
 
-        if (verbose) {
-            // -------------------------------------------------------
-            // Raw byte frequencies for theoretical comparisons.
-            // Shannon / Shannon-Fano / Huffman are all applied to the
-            // raw source bytes so the three schemes are compared fairly.
-            // -------------------------------------------------------
-            vector<int> byte_freq(256, 0);
-            for (unsigned char c : text) byte_freq[c]++;
-
-            // --- Source entropy (bits per source symbol) ---
-            double entropy = 0.0;
-            for (int i = 0; i < 256; i++) {
-                if (byte_freq[i] > 0) {
-                    double p = (double)byte_freq[i] / text.size();
-                    entropy -= p * log2(p);
-                }
-            }
+    if (files.size() != 2 || (range && !unzip)) {
+        printf("Usage: %s [options] input output\n", argv[0]);
+        return 1;
+    }
 
-            // --- Huffman on source bytes ---
-            Node* huff_root = generate_tree(byte_freq);
-            map<int, string> huff_codes;
-            build_codes(huff_root, huff_codes);
-            double huff_avg = 0.0;
-            for (int i = 0; i < 256; i++) {
-                if (byte_freq[i] > 0) {
-                    double p = (double)byte_freq[i] / text.size();
-                    huff_avg += p * huff_codes[i].size();
-                }
-            }
-            double huff_eff = (huff_avg > 0.0) ? entropy / huff_avg : 0.0;
-
-            // --- Shannon coding on source bytes ---
-            ShannonResult sr = shannon_coding(byte_freq);
-
-            // --- Shannon-Fano coding on source bytes ---
-            ShannonResult sfr = shannon_fano_coding(byte_freq);
-
-            // --- N-ary Huffman examples (ternary + quaternary) ---
-            map<int, string> huff3_codes, huff4_codes;
-            NaryNode* huff3_root = generate_tree_nary(byte_freq, 3);
-            NaryNode* huff4_root = generate_tree_nary(byte_freq, 4);
-            build_codes_nary(huff3_root, huff3_codes);
-            build_codes_nary(huff4_root, huff4_codes);
-            double huff3_avg = avg_code_length(byte_freq, huff3_codes);
-            double huff4_avg = avg_code_length(byte_freq, huff4_codes);
-            // Efficiency: for base-n Huffman, optimal avg length is H / log2(n)
-            double huff3_eff = (huff3_avg > 0.0) ? (entropy / log2(3)) / huff3_avg : 0.0;
-            double huff4_eff = (huff4_avg > 0.0) ? (entropy / log2(4)) / huff4_avg : 0.0;
-            free_tree_nary(huff3_root);
-            free_tree_nary(huff4_root);
-
-            // --- Actual compressed stats (whatever mode was used) ---
-            double actual_avg = 0.0;
-            long long token_total = 0;
-            for (int i = 0; i < 288; i++) token_total += freq[i];
-            if (token_total > 0) {
-                for (int i = 0; i < 288; i++) {
-                    if (freq[i] > 0)
-                        actual_avg += (double)freq[i] / token_total * codes[i].size();
-                }
-            }
+    string input_file = files[0];
+    string output_file = files[1];
 
-            // -------------------------------------------------------
-            // Pretty-print using printf to avoid MinGW cout-flush bugs
-            // -------------------------------------------------------
-#define SEP "----------------------------------------------------\n"
+    if (input_file == "-" && range) {
+        fprintf(stderr, "--range needs a seekable input file\n");
+        return 1;
+    }
+    InputFile in;
+    if (!in.open(input_file)) {
+        fprintf(stderr, "Cannot open input file\n");
+        return 1;
+    }
+    OutputFile out;
+    if (!out.open(output_file)) {
+        fprintf(stderr, "Cannot open output file\n");
+        return 1;
+    }
 
-            printf(SEP);
-            printf("  Source statistics\n");
-            printf(SEP);
-            printf("  Symbols (unique / total)  : %zu / %zu\n",
-                huff_codes.size(), text.size());
-            printf("  Shannon entropy           : %.4f bits/symbol\n", entropy);
-            printf(SEP);
-            printf("  Coding scheme comparison (source bytes)\n");
-            printf(SEP);
-            printf("  %-20s  %8s  %10s\n", "Scheme", "Avg len", "Efficiency");
-            printf(SEP);
-            printf("  %-20s  %8.4f  %9.4f%%\n",
-                "Shannon", sr.avg_code_length, sr.efficiency * 100);
-            printf("  %-20s  %8.4f  %9.4f%%\n",
-                "Shannon-Fano", sfr.avg_code_length, sfr.efficiency * 100);
-            printf("  %-20s  %8.4f  %9.4f%%\n",
-                "Huffman (binary)", huff_avg, huff_eff * 100);
-            printf("  %-20s  %8.4f  %9.4f%%  (base-3 symbols)\n",
-                "Huffman (ternary)", huff3_avg, huff3_eff * 100);
-            printf("  %-20s  %8.4f  %9.4f%%  (base-4 symbols)\n",
-                "Huffman (quaternary)", huff4_avg, huff4_eff * 100);
-            printf(SEP);
-            printf("  Actual compression\n");
-            printf(SEP);
-            printf("  Mode                      : %s\n",
-                huffman_only ? "Huffman-only" : "LZ77 + Huffman");
-            printf("  Avg token code length     : %.4f bits\n", actual_avg);
-            printf("  Compressed size           : %u bytes\n", comp_size);
-            printf("  Uncompressed size         : %zu bytes\n", text.size());
-            printf("  Compression ratio         : %.4f\n",
-                (double)comp_size / text.size());
-            printf(SEP);
-            fflush(stdout);
+    // Keep stdout clean for data when writing to it.
+    FILE* log = output_file == "-" ? stderr : stdout;
 
-#undef SEP
-        }
+    if (unzip) {
+        int rc = range ? extract_range(in, out, range_offset, range_length, opt.jobs, dicts)
+                       : decompress_stream(in, out, opt.jobs, dicts);
+        if (rc == 0 && verbose) fprintf(log, "Decompressed successfully\n");
+        return rc;
     }
 
-    return 0;
+    opt.collect_stats = verbose;
+    StreamStats stats;
+    int rc = compress_stream(in, out, opt, stats);
+    if (rc == 0 && verbose)
+        print_stats(log, stats.byte_freq, stats.raw_size, stats.blocks, stats.comp_size, opt.huffman_only);
+    return rc;
 }
@@ -0,0 +1,321 @@
+/*
+Match finder for the LZ77 pre-pass.
+
+MatchFinder indexes every position of the input by the hash of its first three
+bytes and answers "longest earlier match within the window" queries with a
+bounded amount of work per position.  Two search structures are available:
+
+Hash chains (levels 1-7)
+------------------------
+head[h] holds the most recent position whose 3-byte prefix hashes to h and
+prev[] links each position to the previous one with the same hash.  A search
+walks the chain newest-first, so for equal lengths the closest match wins.
+The walk stops after `max_chain` candidates or once a match of `nice_length`
+is found.
+
+Binary trees (levels 8-9)
+-------------------------
+Positions sharing a hash are kept in a binary search tree ordered by the
+bytes that follow them (as in LZMA's bt match finder).  Each insertion
+re-roots the tree at the new position, so the search path visits only the
+candidates that share the longest prefixes with the current string.  This
+finds longer matches than a chain of the same depth, at a higher constant
+cost per position.
+
+Both structures are sized by the reachable window, min(window, input size),
+and the hash table grows with it (16 to 18 bits) so chains stay short when
+the window is many megabytes.
+
+Every position must be passed to find(), find_all() or skip() exactly once,
+in order.  find_all() reports every match length that improves on the
+shorter ones (each with its closest distance), for the optimal parser.
+*/
+
+#pragma once
+#include <bits/stdc++.h>
+#include "kernels.h"
+
+using namespace std;
+
+struct Match {
+    int length;   // 0 if no match of at least MIN_MATCH bytes was found
+    int distance;
+};
+
+// How lz77_compress turns matches into tokens, see lzparse.cpp.
+enum ParseMode {
+    PARSE_GREEDY,    // longest match at each position
+    PARSE_LAZY1,     // defer a match if the next position has a longer one
+    PARSE_LAZY2,     // ... or the one after that
+    PARSE_OPTIMAL,   // cheapest path under the block's code lengths
+};
+
+// Per-level search effort.  Higher levels look at more candidates per
+// position; the binary tree levels also keep every skipped position indexed.
+struct LevelConfig {
+    int  max_chain;    // candidates examined per position
+    int  nice_length;  // stop searching once a match this long is found
+    int  max_insert;   // index positions inside matches up to this length
+    bool binary_tree;  // use the binary tree instead of hash chains
+    ParseMode parse;
+    int  max_lazy;     // lazy parses take a match this long without looking ahead
+};
+
+const int MIN_MATCH      = 3;
+const int DEFAULT_LEVEL  = 6;
+const int DEFAULT_WINDOW = 1 << 20;
+const int MAX_WINDOW     = 1 << 24;   // largest distance the distance codes carry
+
+const LevelConfig LEVELS[10] = {
+    {    0,    0,       0, false, PARSE_GREEDY,    0 },  // 0: unused
+    {    1,    8,       4, false, PARSE_GREEDY,    0 },  // 1: fastest
+    {    4,   16,       8, false, PARSE_GREEDY,    0 },
+    {    8,   32,      16, false, PARSE_GREEDY,    0 },
+    {   16,   64, INT_MAX, false, PARSE_LAZY1,     8 },
+    {   32,  128, INT_MAX, false, PARSE_LAZY1,    16 },
+    {   64,  258, INT_MAX, false, PARSE_LAZY2,    16 },  // 6: default
+    {  128,  258, INT_MAX, false, PARSE_LAZY2,    32 },
+    {   32,  258,     258, true,  PARSE_LAZY2,    64 },
+    {  256, 1024,    1024, true,  PARSE_OPTIMAL, 128 },  // 9: best
+};
+
+class MatchFinder {
+public:
+    MatchFinder() = default;
+    MatchFinder(const uint8_t* data, size_t size, int window_size, int max_length, int level) {
+        reset(data, size, window_size, max_length, level);
+    }
+
+    // Start over on new input.  The tables keep their memory, so a finder
+    // reused for blocks of the same size allocates nothing.
+    void reset(const uint8_t* data_, size_t size_, int window_size, int max_length_, int level) {
+        data = data_;
+        size = size_;
+        window = (int)min((size_t)window_size, max(size, (size_t)1));
+        max_length = max_length_;
+        level = min(max(level, 1), 9);
+        cfg = LEVELS[level];
+        cfg.nice_length = min(cfg.nice_length, max_length);
+        hash_bits = MIN_HASH_BITS;
+        while (hash_bits < MAX_HASH_BITS && (1 << hash_bits) < window) hash_bits++;
+        head.assign((size_t)1 << hash_bits, NIL);
+        cyclic_pos = 0;
+        collect = false;
+        all.clear();
+        if (cfg.binary_tree) {
+            cyclic_size = (uint32_t)window + 1;
+            son.assign(2 * (size_t)cyclic_size, NIL);
+        }
+        else {
+            // Strictly larger than the window so a slot is never reused while
+            // the position it belongs to can still be reached.
+            uint32_t slots = 1;
+            while (slots <= (uint32_t)window) slots <<= 1;
+            prev_mask = slots - 1;
+            prev.assign(slots, NIL);
+        }
+    }
+
+    // Index data[0, prefix), a dictionary, for inputs of up to `capacity`
+    // bytes that start with it.  The dictionary's last two positions are
+    // left out, as their hashes would read past it.
+    void prime(const uint8_t* data_, size_t prefix, size_t capacity, int window_size, int max_length_, int level) {
+        reset(data_, capacity, window_size, max_length_, level);
+        size = prefix;
+        for (size_t p = 0; p < prefix; p++) skip(p);
+    }
+
+    // Start on data_[0, size_), which begins with the dictionary `primed` was
+    // primed with and fits its capacity.  Only the table entries of the
+    // dictionary positions are copied, so it is not indexed again.
+    void resume(const MatchFinder& primed, const uint8_t* data_, size_t size_) {
+        data = data_;
+        size = size_;
+        window = primed.window;
+        max_length = primed.max_length;
+        cfg = primed.cfg;
+        hash_bits = primed.hash_bits;
+        head = primed.head;
+        collect = false;
+        all.clear();
+        // Entries of later positions are written before they are read.
+        if (cfg.binary_tree) {
+            cyclic_size = primed.cyclic_size;
+            cyclic_pos = primed.cyclic_pos;
+            son.resize(primed.son.size());
+            copy_n(primed.son.begin(), min(2 * primed.size, son.size()), son.begin());
+        }
+        else {
+            prev_mask = primed.prev_mask;
+            prev.resize(primed.prev.size());
+            copy_n(primed.prev.begin(), min(primed.size, prev.size()), prev.begin());
+        }
+    }
+
+    const LevelConfig& config() const { return cfg; }
+
+    // Longest match for `pos` against earlier positions; indexes `pos`.
+    // Lazy evaluation passes the length it already holds as `min_length`:
+    // only longer matches are reported, which lets the chain walk reject
+    // candidates sooner.
+    Match find(size_t pos, int min_length = 0) {
+        if (pos + MIN_MATCH > size) { advance(); return { 0, 0 }; }
+        return cfg.binary_tree ? bt_search(pos, true) : hc_search(pos, min_length);
+    }
+
+    // Every match for `pos` that is longer than all closer ones, shortest
+    // first; indexes `pos`.  The result is valid until the next call.
+    const vector<Match>& find_all(size_t pos) {
+        all.clear();
+        collect = true;
+        find(pos);
+        collect = false;
+        return all;
+    }
+
+    // Index `pos` without searching (position covered by an earlier match).
+    // `match_length` is the length of the match that covers it; positions
+    // inside matches longer than max_insert are not indexed.  For the binary
+    // trees that bound is nice_length: inside a longer match every insertion
+    // would compare nice_length bytes, and such runs are found again from
+    // their first positions anyway.
+    void skip(size_t pos, int match_length = 0) {
+        if (pos + MIN_MATCH > size) { advance(); return; }
+        if (cfg.binary_tree) {
+            if (match_length <= cfg.max_insert) bt_search(pos, false);
+            else advance();
+            return;
+        }
+        uint32_t h = hash3(pos);
+        if (match_length <= cfg.max_insert) {
+            prev[pos & prev_mask] = head[h];
+            head[h] = (uint32_t)pos;
+        }
+    }
+
+private:
+    static constexpr int      MIN_HASH_BITS = 16;
+    static constexpr int      MAX_HASH_BITS = 18;
+    static constexpr uint32_t NIL           = UINT32_MAX;
+
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    int window = 1;
+    int max_length = 0;
+    LevelConfig cfg = LEVELS[DEFAULT_LEVEL];
+    int hash_bits = MIN_HASH_BITS;
+
+    vector<uint32_t> head;
+    vector<uint32_t> prev;     // hash chains, indexed by pos & prev_mask
+    uint32_t prev_mask = 0;
+    vector<uint32_t> son;      // binary tree children: [2k] smaller, [2k+1] larger
+    uint32_t cyclic_size = 0;
+    uint32_t cyclic_pos = 0;
+    bool collect = false;      // record improving matches in `all`
+    vector<Match> all;
+
+    uint32_t hash3(size_t pos) const {
+        uint32_t v = (uint32_t)data[pos] | ((uint32_t)data[pos + 1] << 8) | ((uint32_t)data[pos + 2] << 16);
+        return (v * 2654435761u) >> (32 - hash_bits);
+    }
+
+    void advance() {
+        if (cfg.binary_tree && ++cyclic_pos == cyclic_size) cyclic_pos = 0;
+    }
+
+    Match hc_search(size_t pos, int min_length) {
+        uint32_t h = hash3(pos);
+        uint32_t cur = head[h];
+        prev[pos & prev_mask] = cur;
+        head[h] = (uint32_t)pos;
+
+        int limit = (int)min((size_t)max_length, size - pos);
+        size_t lowest = pos > (size_t)window ? pos - window : 0;
+        int best_len = max(MIN_MATCH - 1, min(min_length, limit - 1));
+        int best_dist = 0;
+        int chain = cfg.max_chain;
+
+        while (cur != NIL && cur >= lowest && chain-- > 0) {
+            // Cheap reject: a longer match must also agree at best_len.
+            if (data[cur + best_len] == data[pos + best_len]) {
+                int len = match_length(data + cur, data + pos, limit);
+                if (len > best_len) {
+                    best_len = len;
+                    best_dist = (int)(pos - cur);
+                    if (collect) all.push_back({ len, best_dist });
+                    if (len >= cfg.nice_length || len >= limit) break;
+                }
+            }
+            cur = prev[cur & prev_mask];
+        }
+        if (best_dist == 0) return { 0, 0 };
+        return { best_len, best_dist };
+    }
+
+    // Insert `pos` into its hash bucket's tree, re-rooting the tree at pos.
+    // Smaller strings end up in the left subtree, larger in the right; the
+    // search follows the path a lookup for pos would take.
+    Match bt_search(size_t pos, bool want_match) {
+        uint32_t h = hash3(pos);
+        uint32_t cur = head[h];
+        head[h] = (uint32_t)pos;
+
+        // Tree comparisons stop at nice_length; the best match is extended
+        // to the full limit afterwards.
+        int full_limit = (int)min((size_t)max_length, size - pos);
+        int limit = min(cfg.nice_length, full_limit);
+        uint32_t* ptr_left  = &son[2 * (size_t)cyclic_pos];
+        uint32_t* ptr_right = &son[2 * (size_t)cyclic_pos + 1];
+        int len_left = 0, len_right = 0;
+        int best_len = MIN_MATCH - 1;
+        int best_dist = 0;
+        int depth = cfg.max_chain;
+        const uint8_t* s = data + pos;
+
+        for (;;) {
+            size_t delta = pos - cur;
+            if (cur == NIL || delta > (size_t)window || depth-- == 0) {
+                *ptr_left = *ptr_right = NIL;
+                break;
+            }
+            size_t node = cyclic_pos >= delta ? cyclic_pos - delta : cyclic_pos - delta + cyclic_size;
+            uint32_t* pair = &son[2 * node];
+            const uint8_t* c = data + cur;
+            int len = min(len_left, len_right);
+            if (c[len] == s[len]) {
+                len++;
+                len += match_length(c + len, s + len, limit - len);
+                if (len > best_len) {
+                    best_len = len;
+                    best_dist = (int)delta;
+                    if (collect) all.push_back({ len, best_dist });
+                }
+                if (len >= limit) {
+                    // Identical up to the limit: pos replaces cur in the tree.
+                    *ptr_left = pair[0];
+                    *ptr_right = pair[1];
+                    break;
+                }
+            }
+            if (c[len] < s[len]) {
+                *ptr_left = cur;
+                ptr_left = &pair[1];
+                cur = *ptr_left;
+                len_left = len;
+            }
+            else {
+                *ptr_right = cur;
+                ptr_right = &pair[0];
+                cur = *ptr_right;
+                len_right = len;
+            }
+        }
+        advance();
+        if (!want_match || best_dist == 0) return { 0, 0 };
+        if (best_len == limit) {
+            best_len += match_length(s - best_dist + limit, s + limit, full_limit - limit);
+            if (collect) all.back().length = best_len;
+        }
+        return { best_len, best_dist };
+    }
+};
@@ -1,47 +1,8 @@
-/*
-Shannon and Shannon-Fano coding implementations.
-These are NOT used for actual compression; they exist solely for theoretical
-comparison when the program is run with the -v / --verbose flag.
-
-API:
-  ShannonResult shannon_coding(const vector<int>& freq)
-  ShannonResult shannon_fano_coding(const vector<int>& freq)
-
-Both functions return a ShannonResult which contains the assigned codes,
-the entropy of the source, the average code length, and the coding efficiency
-(= entropy / avg_code_length).
-
-Shannon coding
---------------
-Each symbol i with probability p_i receives a codeword of length
-    l_i = ceil(-log2(p_i))
-The actual codeword is the first l_i bits of the binary expansion of the
-cumulative CDF F_i = sum_{j < i} p_j,  where symbols are sorted by
-descending probability.
-
-Shannon-Fano coding
--------------------
-1. Sort symbols by frequency in descending order.
-2. Recursively split the list at the point that minimises the absolute
-   difference between the total frequency of the left half and the right half.
-3. Prefix '0' for the left group, '1' for the right group.
-*/
-
-#pragma once
 #include <bits/stdc++.h>
+#include "shannon.h"
 
 using namespace std;
 
-// -----------------------------------------------------------------
-// Return type for both Shannon variants
-// -----------------------------------------------------------------
-struct ShannonResult {
-    map<int, string> codes;
-    double entropy;          // Shannon entropy of the source (bits/symbol)
-    double avg_code_length;  // Expected codeword length (bits/symbol)
-    double efficiency;       // entropy / avg_code_length  (1.0 = optimal)
-};
-
 // -----------------------------------------------------------------
 // Internal helpers
 // -----------------------------------------------------------------
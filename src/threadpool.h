@@ -0,0 +1,102 @@
+/*
+Fixed-size worker pool.
+
+submit() queues a callable and returns a future for its result.  Workers
+take tasks in submission order; OrderedPipeline keeps the futures in a queue
+and hands results back oldest first, for callers that need ordered output.
+*/
+
+#pragma once
+#include <bits/stdc++.h>
+
+using namespace std;
+
+class ThreadPool {
+public:
+    explicit ThreadPool(int threads) {
+        threads = max(threads, 1);
+        for (int i = 0; i < threads; i++)
+            workers.emplace_back([this] { run(); });
+    }
+
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> lock(mu);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (thread& t : workers) t.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    template <class F>
+    auto submit(F&& f) -> future<decltype(f())> {
+        using R = decltype(f());
+        auto task = make_shared<packaged_task<R()>>(forward<F>(f));
+        future<R> result = task->get_future();
+        {
+            lock_guard<mutex> lock(mu);
+            tasks.push([task] { (*task)(); });
+        }
+        cv.notify_one();
+        return result;
+    }
+
+    int size() const { return (int)workers.size(); }
+
+    // Worker count for a -j value: 0 means one per hardware thread.
+    static int resolve(int jobs) {
+        if (jobs > 0) return jobs;
+        return max(1, (int)thread::hardware_concurrency());
+    }
+
+private:
+    vector<thread> workers;
+    queue<function<void()>> tasks;
+    mutex mu;
+    condition_variable cv;
+    bool stopping = false;
+
+    void run() {
+        for (;;) {
+            function<void()> task;
+            {
+                unique_lock<mutex> lock(mu);
+                cv.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (tasks.empty()) return;
+                task = move(tasks.front());
+                tasks.pop();
+            }
+            task();
+        }
+    }
+};
+
+// Runs jobs on a pool and returns their results in submission order, with at
+// most two jobs per worker in flight.  Callers drain one result whenever
+// full() before submitting the next job.
+template <class R>
+class OrderedPipeline {
+public:
+    explicit OrderedPipeline(ThreadPool& pool) : pool(pool), limit(2 * (size_t)pool.size()) {}
+
+    bool full() const { return pending.size() >= limit; }
+    bool empty() const { return pending.empty(); }
+
+    template <class F>
+    void submit(F&& job) { pending.push_back(pool.submit(forward<F>(job))); }
+
+    // Wait for and return the oldest result.
+    R next() {
+        R r = pending.front().get();
+        pending.pop_front();
+        return r;
+    }
+
+private:
+    ThreadPool& pool;
+    size_t limit;
+    deque<future<R>> pending;
+};
@@ -0,0 +1,62 @@
+/*
+Stage timing for --bench.
+
+Stopwatch measures wall time with steady_clock and, on x86, reference cycles
+with the time-stamp counter.  lap() returns the time since the last lap (or
+start) and restarts the watch, so consecutive stages are timed without gaps.
+StageTime accumulates the laps of one stage.
+*/
+
+#pragma once
+#include <bits/stdc++.h>
+#include "cpu.h"
+#ifdef HUFFZIP_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+using namespace std;
+
+struct StageTime {
+    double seconds = 0;
+    uint64_t cycles = 0;   // 0 where no cycle counter is available
+
+    void add(const StageTime& o) {
+        seconds += o.seconds;
+        cycles += o.cycles;
+    }
+};
+
+static inline uint64_t _read_cycles() {
+#ifdef HUFFZIP_X86
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+class Stopwatch {
+public:
+    Stopwatch() { start(); }
+
+    void start() {
+        t0 = chrono::steady_clock::now();
+        c0 = _read_cycles();
+    }
+
+    StageTime lap() {
+        auto t1 = chrono::steady_clock::now();
+        uint64_t c1 = _read_cycles();
+        StageTime s{ chrono::duration<double>(t1 - t0).count(), c1 - c0 };
+        t0 = t1;
+        c0 = c1;
+        return s;
+    }
+
+private:
+    chrono::steady_clock::time_point t0;
+    uint64_t c0 = 0;
+};
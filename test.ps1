@@ -26,27 +26,47 @@ function Test-String {
 }
 
 function Test-File {
-    param([string]$path, [switch]$HuffmanOnly)
+    param([string]$path, [switch]$HuffmanOnly, [string[]]$Options = @())
 
     $name = [System.IO.Path]::GetFileName($path)
     $comp = "$tmp\$name.huff"
     $dec  = "$tmp\$name.dec"
 
-    Run-Huffzip $path $comp $dec $HuffmanOnly
+    Run-Huffzip $path $comp $dec $HuffmanOnly $Options
 
     $orig = [System.IO.File]::ReadAllBytes($path)
     $got  = [System.IO.File]::ReadAllBytes($dec)
-    Report $name $HuffmanOnly ([System.Linq.Enumerable]::SequenceEqual($orig, $got))
+    Report $name $HuffmanOnly ([System.Linq.Enumerable]::SequenceEqual($orig, $got)) $Options
 }
 
-function Run-Huffzip([string]$src, [string]$comp, [string]$dec, [bool]$HuffmanOnly) {
-    if ($HuffmanOnly) { & $exe --huffman $src $comp 2>$null }
-    else              { & $exe           $src $comp 2>$null }
+function Run-Huffzip([string]$src, [string]$comp, [string]$dec, [bool]$HuffmanOnly, [string[]]$Options = @()) {
+    $opts = @()
+    if ($HuffmanOnly) { $opts += "--huffman" }
+    $opts += $Options
+    & $exe @opts $src $comp 2>$null
     & $exe -u $comp $dec 2>$null
 }
 
-function Report([string]$name, [bool]$HuffmanOnly, [bool]$ok) {
+function Test-Range {
+    param([string]$path, [long]$offset, [long]$length)
+
+    $name = [System.IO.Path]::GetFileName($path)
+    $comp = "$tmp\$name.huff"
+    $dec  = "$tmp\$name.range"
+
+    & $exe --block-size 1K $path $comp 2>$null
+    & $exe -u -j 2 --range "${offset}:${length}" $comp $dec 2>$null
+
+    $orig = [System.IO.File]::ReadAllBytes($path)
+    $end  = [Math]::Min($orig.Length, $offset + $length)
+    $want = if ($offset -lt $end) { $orig[$offset..($end - 1)] } else { @() }
+    $got  = [System.IO.File]::ReadAllBytes($dec)
+    Report $name $false ([System.Linq.Enumerable]::SequenceEqual([byte[]]$want, $got)) @("--range", "${offset}:${length}")
+}
+
+function Report([string]$name, [bool]$HuffmanOnly, [bool]$ok, [string[]]$Options = @()) {
     $mode = if ($HuffmanOnly) { "Huffman-only" } else { "LZ77+Huffman" }
+    if ($Options.Count -gt 0) { $mode += " " + ($Options -join " ") }
     if ($ok) { Write-Host "  [PASS] $name ($mode)"; $script:pass++ }
     else      { Write-Host "  [FAIL] $name ($mode)"; $script:fail++ }
 }
@@ -89,11 +109,30 @@ foreach ($f in $files) {
     if (Test-Path $f) {
         Test-File -path $f
         Test-File -path $f -HuffmanOnly
+        Test-File -path $f -Options "-1"
+        Test-File -path $f -Options "-9"
+        Test-File -path $f -Options "--block-size", "4K"
+        Test-File -path $f -HuffmanOnly -Options "--block-size", "4K"
+        Test-File -path $f -Options "-j", "4", "--block-size", "4K"
+        Test-File -path $f -Options "-9", "--window", "16M"
     } else {
         Write-Host "  [SKIP] $f not found"
     }
 }
 
+# ── random access ─────────────────────────────────────────────────────────
+
+Write-Host ""
+Write-Host "  -- block index / --range --"
+
+foreach ($f in $files) {
+    if (Test-Path $f) {
+        Test-Range -path $f -offset 0    -length 100
+        Test-Range -path $f -offset 1000 -length 3000
+        Test-Range -path $f -offset 1023 -length 1000000
+    }
+}
+
 # ── summary ───────────────────────────────────────────────────────────────
 
 Write-Host ""
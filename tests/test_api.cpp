@@ -0,0 +1,261 @@
+/*
+Checks the library API (huffzip.h) as an embedding program sees it: one-shot
+round trips in every mode, streaming in pieces of awkward sizes on both
+sides, per-block coding of mixed and random input, context reuse,
+dictionaries, and rejection of damaged or truncated input.
+
+Only the public header is included; the test links the huffzip library.
+*/
+
+#include <bits/stdc++.h>
+#include "huffzip.h"
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool ok, const char* what, const string& detail) {
+    if (ok) return;
+    failures++;
+    fprintf(stderr, "FAIL %s: %s\n", what, detail.c_str());
+}
+
+static vector<uint8_t> sample(mt19937& rng, size_t size) {
+    static const char* words[] = { "block ", "window ", "match ", "length ", "huffman ", "code ", "the ", "a " };
+    vector<uint8_t> data;
+    while (data.size() < size) {
+        if (rng() % 16 == 0) data.push_back((uint8_t)rng());
+        else for (const char* w = words[rng() % 8]; *w && data.size() < size; w++) data.push_back(*w);
+    }
+    return data;
+}
+
+// Feed `data` to a streaming context in pieces of the given sizes, cycling.
+template <class Context>
+static bool stream(Context& ctx, const vector<uint8_t>& data, const vector<size_t>& pieces, vector<uint8_t>& out) {
+    out.clear();
+    size_t pos = 0;
+    for (size_t i = 0; pos < data.size(); i++) {
+        size_t n = min(pieces[i % pieces.size()], data.size() - pos);
+        if (!ctx.write(data.data() + pos, n, out)) return false;
+        pos += n;
+    }
+    return ctx.finish(out);
+}
+
+static void test_round_trips(mt19937& rng) {
+    vector<HuffzipOptions> modes(4);
+    modes[0].huffman_only = true;
+    modes[1].level = 1;
+    modes[3].level = 9;
+    modes[3].block_size = 64 << 10;   // several blocks
+
+    HuffzipDecompressor dec;
+    vector<uint8_t> packed, back;
+    for (auto& opt : modes) {
+        HuffzipCompressor comp(opt);
+        for (size_t size : { 0, 1, 100, 65536, 65537, 300000 }) {
+            vector<uint8_t> data = sample(rng, size);
+            string what = "level " + to_string(opt.level) + (opt.huffman_only ? " huffman" : "") + " size "
+                + to_string(size);
+            bool ok = huffzip_compress(comp, data.data(), data.size(), packed)
+                && huffzip_decompress(dec, packed.data(), packed.size(), back);
+            check(ok && back == data, "one-shot", what);
+
+            // The streamed form matches the one-shot form byte for byte.
+            vector<uint8_t> streamed;
+            ok = stream(comp, data, { 1, 7, 4096, 70001 }, streamed);
+            check(ok && streamed == packed, "stream compress", what);
+            ok = stream(dec, packed, { 3, 1, 5, 9, 12345 }, back);
+            check(ok && back == data, "stream decompress", what);
+        }
+    }
+}
+
+// Input whose character changes is cut into blocks coded each its own way,
+// and incompressible input is stored rather than expanded, but not data that
+// only looks random.
+static void test_block_modes(mt19937& rng) {
+    vector<uint8_t> text = sample(rng, 100000), noise(100000), data;
+    for (auto& b : noise) b = (uint8_t)rng();
+    data.insert(data.end(), text.begin(), text.end());
+    data.insert(data.end(), noise.begin(), noise.end());
+    data.insert(data.end(), 50000, 0);
+    data.insert(data.end(), text.begin(), text.end());
+
+    HuffzipDecompressor dec;
+    vector<uint8_t> packed, back;
+    for (bool huffman_only : { false, true }) {
+        HuffzipOptions opt;
+        opt.huffman_only = huffman_only;
+        HuffzipCompressor comp(opt);
+        const char* mode = huffman_only ? "huffman" : "lz77";
+        bool ok = huffzip_compress(comp, data.data(), data.size(), packed)
+            && huffzip_decompress(dec, packed.data(), packed.size(), back);
+        check(ok && back == data, "mixed input", mode);
+        size_t mixed_size = packed.size();
+
+        ok = huffzip_compress(comp, noise.data(), noise.size(), packed)
+            && huffzip_decompress(dec, packed.data(), packed.size(), back);
+        check(ok && back == noise, "random input", mode);
+        check(packed.size() <= noise.size() + 100, "random input",
+            string(mode) + ": expanded to " + to_string(packed.size()));
+        check(mixed_size < packed.size() + data.size() - noise.size(), "mixed input",
+            string(mode) + ": compressible parts did not shrink");
+    }
+
+    // Random data that repeats is not taken for incompressible.
+    vector<uint8_t> repeated;
+    for (int i = 0; i < 4; i++) repeated.insert(repeated.end(), noise.begin(), noise.begin() + 50000);
+    HuffzipCompressor comp;
+    bool ok = huffzip_compress(comp, repeated.data(), repeated.size(), packed)
+        && huffzip_decompress(dec, packed.data(), packed.size(), back);
+    check(ok && back == repeated && packed.size() < repeated.size() / 2, "repeated random input",
+        "packed to " + to_string(packed.size()));
+}
+
+// Reusing contexts and output vectors of one size must not allocate.
+static void test_reuse(mt19937& rng) {
+    vector<uint8_t> data = sample(rng, 200000), packed, back;
+    HuffzipCompressor comp;
+    HuffzipDecompressor dec;
+    huffzip_compress(comp, data.data(), data.size(), packed);
+    huffzip_decompress(dec, packed.data(), packed.size(), back);
+    const uint8_t* packed_buf = packed.data();
+    const uint8_t* back_buf = back.data();
+    for (int i = 0; i < 3; i++) {
+        bool ok = huffzip_compress(comp, data.data(), data.size(), packed)
+            && huffzip_decompress(dec, packed.data(), packed.size(), back);
+        check(ok && back == data, "reuse", "round " + to_string(i));
+    }
+    check(packed.data() == packed_buf && back.data() == back_buf, "reuse", "output buffers were reallocated");
+}
+
+static void test_errors(mt19937& rng) {
+    vector<uint8_t> data = sample(rng, 50000), packed, back;
+    HuffzipCompressor comp;
+    HuffzipDecompressor dec;
+    huffzip_compress(comp, data.data(), data.size(), packed);
+
+    for (size_t cut : { (size_t)0, (size_t)5, (size_t)20, packed.size() / 2, packed.size() - 1 }) {
+        bool ok = huffzip_decompress(dec, packed.data(), cut, back);
+        check(!ok && dec.error(), "truncated", "cut at " + to_string(cut));
+    }
+    for (size_t at : { (size_t)0, (size_t)30, packed.size() / 2, packed.size() - 2 }) {
+        vector<uint8_t> bad = packed;
+        bad[at] ^= 0x55;
+        check(!huffzip_decompress(dec, bad.data(), bad.size(), back), "corrupt", "byte " + to_string(at));
+    }
+    vector<uint8_t> extra = packed;
+    extra.push_back(0);
+    check(!huffzip_decompress(dec, extra.data(), extra.size(), back), "trailing data", "accepted");
+
+    // A failed context is usable again after a reset.
+    check(huffzip_decompress(dec, packed.data(), packed.size(), back) && back == data, "after error", "");
+
+    HuffzipOptions opt;
+    opt.level = 12;
+    HuffzipCompressor invalid(opt);
+    check(invalid.error() && !huffzip_compress(invalid, data.data(), data.size(), packed), "options",
+        "level 12 accepted");
+}
+
+// Small records sharing a layout, as a dictionary is meant for.
+static vector<uint8_t> record(mt19937& rng) {
+    static const char* status[] = { "pending", "shipped", "delivered" };
+    string r = "{\"request_id\": \"" + to_string(rng()) + "\", \"status\": \"" + status[rng() % 3] + "\", \"items\": [";
+    for (int i = 0, n = 2 + rng() % 20; i < n; i++)
+        r += "{\"sku\": \"SKU-" + to_string(rng() % 100000) + "\", \"quantity\": " + to_string(rng() % 9)
+            + ", \"currency\": \"USD\"}, ";
+    r += "]}";
+    return vector<uint8_t>(r.begin(), r.end());
+}
+
+static void test_dictionary(mt19937& rng) {
+    vector<vector<uint8_t>> samples;
+    for (int i = 0; i < 300; i++) samples.push_back(record(rng));
+    HuffzipDictionary trained, loaded;
+    check(trained.train(samples, 8 << 10) && trained.id() != 0, "dictionary", "training failed");
+    vector<uint8_t> file = trained.save();
+    check(loaded.load(file.data(), file.size()) && loaded.id() == trained.id(), "dictionary", "reload failed");
+    file[file.size() / 2] ^= 1;
+    check(!HuffzipDictionary().load(file.data(), file.size()), "dictionary", "damaged file loaded");
+
+    for (bool huffman_only : { false, true }) {
+        HuffzipOptions opt;
+        opt.huffman_only = huffman_only;
+        HuffzipCompressor plain(opt);
+        opt.dictionary = &loaded;
+        HuffzipCompressor comp(opt);
+        HuffzipDecompressor dec, other;
+        dec.add_dictionary(trained);
+        size_t plain_total = 0, dict_total = 0;
+        vector<uint8_t> packed, back;
+        for (int i = 0; i < 50; i++) {
+            vector<uint8_t> data = record(rng);
+            huffzip_compress(plain, data.data(), data.size(), packed);
+            plain_total += packed.size();
+            bool ok = huffzip_compress(comp, data.data(), data.size(), packed)
+                && huffzip_decompress(dec, packed.data(), packed.size(), back);
+            check(ok && back == data, "dictionary", "round trip " + to_string(i));
+            dict_total += packed.size();
+            check(!huffzip_decompress(other, packed.data(), packed.size(), back), "dictionary",
+                "decoded without the dictionary");
+        }
+        check(dict_total < plain_total, "dictionary",
+            "no gain: " + to_string(dict_total) + " >= " + to_string(plain_total) + (huffman_only ? " (huffman)" : ""));
+    }
+}
+
+// Input cut into several blocks, where a later block repeats the end of the
+// dictionary's content followed by the start of the input: the match runs
+// past the dictionary's end, which that block cannot follow.
+static void test_dictionary_blocks(mt19937& rng) {
+    vector<vector<uint8_t>> samples;
+    for (int i = 0; i < 300; i++) samples.push_back(record(rng));
+    HuffzipDictionary dict;
+    check(dict.train(samples, 8 << 10), "dictionary blocks", "training failed");
+    vector<uint8_t> file = dict.save();
+    const uint8_t* content = file.data() + 16;   // after the fixed header, see dictionary.cpp
+    size_t content_size = file[12] | file[13] << 8 | file[14] << 16 | (size_t)file[15] << 24;
+
+    // Digits, noise, then the dictionary's tail, the first digits again and
+    // text; only the short match across the dictionary's end reaches back
+    // past the cuts.
+    vector<uint8_t> data, text = sample(rng, 30000);
+    for (int i = 0; i < 20000; i++) data.push_back((uint8_t)('0' + rng() % 10));
+    for (int i = 0; i < 50000; i++) data.push_back((uint8_t)rng());
+    vector<uint8_t> digits(data.begin(), data.begin() + 100);
+    data.insert(data.end(), content + content_size - 200, content + content_size);
+    data.insert(data.end(), digits.begin(), digits.end());
+    data.insert(data.end(), text.begin(), text.end());
+
+    HuffzipDecompressor dec;
+    dec.add_dictionary(dict);
+    vector<uint8_t> packed, back;
+    for (int level : { 1, 6, 9 }) {
+        HuffzipOptions opt;
+        opt.level = level;
+        opt.dictionary = &dict;
+        HuffzipCompressor comp(opt);
+        bool ok = huffzip_compress(comp, data.data(), data.size(), packed)
+            && huffzip_decompress(dec, packed.data(), packed.size(), back);
+        check(ok && back == data, "dictionary blocks", "level " + to_string(level));
+    }
+}
+
+int main() {
+    mt19937 rng(4242);
+    test_round_trips(rng);
+    test_block_modes(rng);
+    test_reuse(rng);
+    test_errors(rng);
+    test_dictionary(rng);
+    test_dictionary_blocks(rng);
+    if (failures) {
+        fprintf(stderr, "%d API test(s) failed\n", failures);
+        return 1;
+    }
+    printf("API tests passed\n");
+    return 0;
+}
@@ -0,0 +1,164 @@
+/*
+Round-trips the generated corpus (bench_corpus() in bench.cpp) through the
+container in every mode, and guards the compression ratio: each compressed
+size is compared with the baseline in corpus_sizes.txt and the test fails if
+any file got larger.  The corpus is deterministic, so the sizes only change
+when the coder does.  Truncated streams and streams with trailing data must
+be rejected.
+
+Usage:  test_corpus <corpus_sizes.txt> [--update]
+    --update rewrites the baseline with the current sizes.
+*/
+
+#include <bits/stdc++.h>
+#include "bench.h"
+
+using namespace std;
+
+struct Mode {
+    const char* name;
+    bool huffman_only;
+    int level;
+    size_t block_size;
+};
+
+static const Mode MODES[] = {
+    { "huffman", true, 6, DEFAULT_BLOCK_SIZE },
+    { "1", false, 1, DEFAULT_BLOCK_SIZE },
+    { "6", false, 6, DEFAULT_BLOCK_SIZE },
+    { "9", false, 9, DEFAULT_BLOCK_SIZE },
+    { "6-blocks", false, 6, 64 << 10 },   // several blocks per file
+};
+
+static bool write_file(const string& path, const vector<uint8_t>& data) {
+    OutputFile out;
+    if (!out.open(path)) return false;
+    out.write(data.data(), data.size());
+    return out.close();
+}
+
+static bool read_file(const string& path, vector<uint8_t>& data) {
+    InputFile in;
+    if (!in.open(path)) return false;
+    data.clear();
+    for (;;) {
+        Chunk c = in.take(IO_BUFFER_SIZE);
+        if (c.size == 0) break;
+        data.insert(data.end(), c.data, c.data + c.size);
+    }
+    return !in.failed();
+}
+
+// Compressed size of `data`, or 0 if the round trip failed.
+static uint64_t round_trip(const vector<uint8_t>& data, const Mode& mode, const string& dir) {
+    string raw = dir + "/raw", comp = dir + "/comp", dec = dir + "/dec";
+    if (!write_file(raw, data)) return 0;
+
+    StreamOptions opt;
+    opt.huffman_only = mode.huffman_only;
+    opt.level = mode.level;
+    opt.block_size = mode.block_size;
+    opt.jobs = 2;
+    StreamStats stats;
+    {
+        InputFile in;
+        OutputFile out;
+        if (!in.open(raw) || !out.open(comp) || compress_stream(in, out, opt, stats) != 0) return 0;
+    }
+    {
+        InputFile in;
+        OutputFile out;
+        if (!in.open(comp) || !out.open(dec) || decompress_stream(in, out, 2) != 0) return 0;
+    }
+    vector<uint8_t> back;
+    if (!read_file(dec, back) || back != data) return 0;
+    return stats.comp_size;
+}
+
+// A compressed stream cut anywhere in its trailer, or with bytes after it,
+// must not decompress.  Returns the number of damaged forms accepted.
+static int check_damaged(const string& packed_path, const string& dir) {
+    vector<uint8_t> packed;
+    if (!read_file(packed_path, packed) || packed.size() < TRAILER_SIZE) return 1;
+    auto accepted = [&](const vector<uint8_t>& bad) {
+        InputFile in;
+        OutputFile out;
+        return write_file(dir + "/bad", bad) && in.open(dir + "/bad") && out.open(dir + "/dec")
+            && decompress_stream(in, out, 2) == 0;
+    };
+    int failures = 0;
+    for (size_t cut = 1; cut <= TRAILER_SIZE; cut++) {
+        if (accepted(vector<uint8_t>(packed.begin(), packed.end() - cut))) {
+            fprintf(stderr, "FAIL damaged: stream missing its last %zu bytes accepted\n", cut);
+            failures++;
+        }
+    }
+    vector<uint8_t> extra = packed;
+    extra.push_back(0);
+    if (accepted(extra)) {
+        fprintf(stderr, "FAIL damaged: trailing data accepted\n");
+        failures++;
+    }
+    return failures;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <corpus_sizes.txt> [--update]\n", argv[0]);
+        return 1;
+    }
+    string baseline_path = argv[1];
+    bool update = argc > 2 && string(argv[2]) == "--update";
+
+    map<string, uint64_t> baseline;
+    {
+        ifstream f(baseline_path);
+        string key;
+        uint64_t size;
+        while (f >> key >> size) baseline[key] = size;
+    }
+
+    string dir = (filesystem::temp_directory_path() / ("huffzip_test_corpus_" + to_string(random_device{}()))).string();
+    filesystem::create_directories(dir);
+
+    int failures = 0;
+    map<string, uint64_t> current;
+    printf("%-10s %-10s %10s %10s %10s\n", "Mode", "File", "Raw", "Packed", "Baseline");
+    for (const BenchInput& input : bench_corpus()) {
+        for (const Mode& mode : MODES) {
+            string key = string(mode.name) + "/" + input.name;
+            uint64_t size = round_trip(input.data, mode, dir);
+            if (size == 0) {
+                fprintf(stderr, "FAIL %s: round trip failed\n", key.c_str());
+                failures++;
+                continue;
+            }
+            current[key] = size;
+            auto it = baseline.find(key);
+            printf("%-10s %-10s %10zu %10llu %10s\n", mode.name, input.name.c_str(), input.data.size(),
+                (unsigned long long)size, it == baseline.end() ? "-" : to_string(it->second).c_str());
+            if (!update && it != baseline.end() && size > it->second) {
+                fprintf(stderr, "FAIL %s: %llu bytes, baseline %llu\n", key.c_str(), (unsigned long long)size,
+                    (unsigned long long)it->second);
+                failures++;
+            }
+        }
+    }
+    failures += check_damaged(dir + "/comp", dir);
+    filesystem::remove_all(dir);
+
+    if (update) {
+        ofstream f(baseline_path);
+        for (auto& [key, size] : current) f << key << " " << size << "\n";
+        if (!f) {
+            fprintf(stderr, "Cannot write %s\n", baseline_path.c_str());
+            return 1;
+        }
+        printf("Baseline updated: %s\n", baseline_path.c_str());
+    }
+    if (failures) {
+        fprintf(stderr, "%d corpus test(s) failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,262 @@
+/*
+Checks the accelerated kernels in kernels.cpp against their byte-at-a-time
+reference versions.  Every engine this CPU can run is tested, on random data
+and on data built to put the first mismatch at every offset.  The wide LZ77
+match copy of the decoder (huffman.cpp) is checked the same way, and so are
+four-stream Huffman coding and the tANS coder (fse.cpp), on bytes and on
+LZ77 tokens.
+
+Built by CMake against huffzip_core; run as `ctest -R test_kernels`.
+*/
+
+#include <bits/stdc++.h>
+#include "huffman.h"
+#include "fse.h"
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool ok, const char* what, const string& detail) {
+    if (ok) return;
+    failures++;
+    fprintf(stderr, "FAIL %s: %s\n", what, detail.c_str());
+}
+
+static void test_histogram(mt19937& rng) {
+    vector<size_t> sizes = { 0, 1, 7, 8, 9, 63, 64, 65, 1000, 100003 };
+    for (size_t size : sizes) {
+        for (int kind = 0; kind < 3; kind++) {
+            vector<uint8_t> data(size);
+            for (size_t i = 0; i < size; i++) {
+                if (kind == 0) data[i] = (uint8_t)rng();
+                else if (kind == 1) data[i] = 'a';              // one repeated byte
+                else data[i] = (uint8_t)(rng() % 4 ? 0 : rng());  // skewed
+            }
+            uint32_t want[256], got[256];
+            for (int s = 0; s < 256; s++) want[s] = got[s] = (uint32_t)s;  // counts are added to
+            _histogram_scalar(data.data(), size, want);
+            histogram(data.data(), size, got);
+            check(memcmp(want, got, sizeof want) == 0, "histogram",
+                "size " + to_string(size) + " kind " + to_string(kind));
+        }
+    }
+}
+
+static void test_match_length(mt19937& rng) {
+    vector<pair<const char*, MatchLengthFn>> engines = { { "word", _match_length_word } };
+#ifdef HUFFZIP_SIMD_COMPARE
+    if (cpu_features().sse2) engines.push_back({ "sse2", _match_length_sse2 });
+    if (cpu_features().avx2) engines.push_back({ "avx2", _match_length_avx2 });
+#endif
+    engines.push_back({ "dispatch", match_length });
+
+    const int N = 300;
+    vector<uint8_t> a(N), b(N);
+    for (auto& e : engines) {
+        // First mismatch at every offset, with every limit around it.
+        for (int diff = 0; diff <= N; diff++) {
+            for (int i = 0; i < N; i++) a[i] = b[i] = (uint8_t)rng();
+            if (diff < N) b[diff] ^= (uint8_t)(1 + rng() % 255);
+            for (int limit : { 0, 1, diff - 1, diff, diff + 1, diff + 17, diff + 33, N }) {
+                if (limit < 0 || limit > N) continue;
+                int want = _match_length_bytes(a.data(), b.data(), limit);
+                int got = e.second(a.data(), b.data(), limit);
+                check(want == got, e.first,
+                    "diff " + to_string(diff) + " limit " + to_string(limit) + ": " + to_string(got)
+                        + " != " + to_string(want));
+            }
+        }
+        // Inputs ending exactly at `limit`: the kernels must not read past it.
+        for (int limit = 0; limit <= 70; limit++) {
+            vector<uint8_t> x(limit, 'z'), y(limit, 'z');
+            int got = e.second(x.data(), y.data(), limit);
+            check(got == limit, e.first, "equal inputs of " + to_string(limit) + " bytes");
+        }
+    }
+}
+
+// Every short distance, every length up to a few words, with the match
+// ending at and near the end of the output.
+static void test_copy_match(mt19937& rng) {
+    for (size_t distance = 1; distance <= 40; distance++) {
+        for (size_t length = 0; length <= 100; length++) {
+            for (size_t tail : { 0, 1, 15, 16, 17, 64 }) {
+                size_t size = distance + length + tail;
+                vector<uint8_t> want(size), got(size);
+                for (size_t i = 0; i < distance; i++) want[i] = got[i] = (uint8_t)rng();
+                for (size_t k = 0; k < length; k++) want[distance + k] = want[k];
+                _copy_match(got.data() + distance, distance, length, got.data() + size);
+                check(memcmp(want.data(), got.data(), distance + length) == 0, "copy_match",
+                    "distance " + to_string(distance) + " length " + to_string(length) + " tail " + to_string(tail));
+            }
+        }
+    }
+}
+
+// Four-stream Huffman coding round trips at sizes that do not split evenly,
+// after a partial byte, and rejects a damaged jump table or a short payload.
+static void test_huffman4(mt19937& rng) {
+    uint32_t freq[256];
+    for (int s = 0; s < 256; s++) freq[s] = 1 + (s < 16 ? 1000 >> (s / 2) : 0);
+    CodeTable table;
+    build_code_table(freq, 256, MAX_CODE_LEN, table);
+    HuffDecoder dec;
+    dec.build(table.len, 256);
+    discrete_distribution<int> dist(freq, freq + 256);
+
+    for (size_t size : { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 100, 16387 }) {
+        vector<uint8_t> data(size), back(size);
+        for (auto& b : data) b = (uint8_t)dist(rng);
+        BitWriter w;
+        w.write(5, 3);
+        encode_bytes4(table, data.data(), size, w);
+        vector<uint8_t>& packed = w.finish();
+        bool ok = decode_huffman4(dec, packed.data() + 1, packed.size() - 1, back.data(), size);
+        check(ok && back == data, "huffman4", "size " + to_string(size));
+        if (size != 16387) continue;
+
+        check(!decode_huffman4(dec, packed.data() + 1, packed.size() - 2, back.data(), size), "huffman4",
+            "short payload accepted");
+        packed[4] ^= 0x40;   // top byte of the first stream's size
+        check(!decode_huffman4(dec, packed.data() + 1, packed.size() - 1, back.data(), size), "huffman4",
+            "bad jump table accepted");
+    }
+}
+
+// tANS round trips of skewed, single-symbol and tiny inputs come within 1%
+// of the entropy, and damaged counts are rejected.
+static void test_fse(mt19937& rng) {
+    FseTable table;
+    FseDecoder dec;
+    uint16_t norm[256];
+    vector<uint8_t> scratch;
+    for (int kind = 0; kind < 3; kind++) {
+        for (size_t size : { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 100000 }) {
+            vector<uint8_t> data(size), back(size);
+            for (auto& b : data) {
+                if (kind == 0) b = (uint8_t)(rng() % 10 ? 0 : 1 + rng() % 3);   // mostly one symbol
+                else if (kind == 1) b = 'x';
+                else b = (uint8_t)(rng() % 200);
+            }
+            uint32_t freq[256] = {};
+            histogram(data.data(), size, freq);
+            build_fse_table(freq, 256, FSE_MAX_TABLE_LOG, table);
+            BitWriter w;
+            write_fse_counts(w, table);
+            uint64_t header = w.bit_count();
+            fse_encode_bytes(table, data.data(), size, w, scratch);
+            uint64_t data_bits = w.bit_count() - header - 2 * table.table_log;
+            vector<uint8_t>& packed = w.finish();
+
+            string what = "kind " + to_string(kind) + " size " + to_string(size);
+            BitReader in(packed.data(), packed.size());
+            int log;
+            bool ok = read_fse_counts(in, 256, norm, log) && log == table.table_log;
+            if (ok) {
+                dec.build(norm, 256, log);
+                ok = fse_decode_bytes(dec, in, back.data(), size);
+            }
+            check(ok && back == data, "fse", what);
+            if (size < 100000) continue;
+            double entropy = 0;
+            for (int s = 0; s < 256; s++)
+                if (freq[s]) entropy += freq[s] * log2((double)size / freq[s]);
+            check(data_bits <= entropy * 1.01 + 64, "fse",
+                what + ": " + to_string(data_bits) + " bits for entropy " + to_string((uint64_t)entropy));
+        }
+    }
+
+    // Counts that do not add up to the table size.
+    BitWriter w;
+    w.write(7, 3);
+    for (int s = 0; s < 256; s++) w.write(1, 13);
+    vector<uint8_t>& bad = w.finish();
+    BitReader in(bad.data(), bad.size());
+    int log;
+    check(!read_fse_counts(in, 256, norm, log), "fse", "bad counts accepted");
+}
+
+// tANS coded LZ77 tokens (fse_encode_tokens) round trip through decode_lz77:
+// literals, matches with length and distance extra bits, and a block without
+// matches.  A payload cut short, and a literal state that starts with a
+// match, are rejected.
+static void test_fse_tokens(mt19937& rng) {
+    FseTable lit, dist;
+    FseDecoder lit_dec, dist_dec;
+    uint16_t norm[NUM_SYMBOLS];
+    vector<uint8_t> scratch;
+    for (bool matches : { true, false }) {
+        vector<uint8_t> data;
+        vector<LZToken> tokens;
+        while (data.size() < 100000) {
+            if (!matches || data.size() < 3 || rng() % 4) {
+                data.push_back((uint8_t)('a' + rng() % 20));
+                tokens.push_back({ true, (char)data.back(), 0, 0 });
+                continue;
+            }
+            int distance = 1 + (int)(rng() % data.size()), length = MIN_MATCH + (int)(rng() % (rng() % 8 ? 16 : 2000));
+            for (int k = 0; k < length; k++) data.push_back(data[data.size() - distance]);
+            tokens.push_back({ false, 0, distance, length });
+        }
+        uint32_t freq[NUM_SYMBOLS] = {}, dist_freq[NUM_DIST_SYMBOLS] = {};
+        for (auto& t : tokens) {
+            if (t.is_literal) freq[(unsigned char)t.literal]++;
+            else {
+                freq[256 + length_code(t.length)]++;
+                dist_freq[dist_code(t.distance)]++;
+            }
+        }
+        build_fse_table(freq, NUM_SYMBOLS, FSE_MAX_TABLE_LOG, lit);
+        build_fse_table(dist_freq, NUM_DIST_SYMBOLS, FSE_MAX_TABLE_LOG, dist);
+        BitWriter w;
+        write_fse_counts(w, lit);
+        write_fse_counts(w, dist);
+        uint64_t header = w.bit_count();
+        fse_encode_tokens(lit, dist, tokens, w, scratch);
+        vector<uint8_t>& packed = w.finish();
+
+        string what = matches ? "with matches" : "literals only";
+        auto decode = [&](size_t packed_size, vector<uint8_t>& back) {
+            BitReader in(packed.data(), packed_size);
+            int log;
+            if (!read_fse_counts(in, NUM_SYMBOLS, norm, log)) return false;
+            lit_dec.build(norm, NUM_SYMBOLS, log);
+            if (!read_fse_counts(in, NUM_DIST_SYMBOLS, norm, log)) return false;
+            dist_dec.build(norm, NUM_DIST_SYMBOLS, log);
+            FseState lit_state(lit_dec, in), dist_state(dist_dec, in);
+            return decode_lz77(lit_state, dist_state, in, back.data(), back.size());
+        };
+        vector<uint8_t> back(data.size());
+        check(decode(packed.size(), back) && back == data, "fse tokens", what);
+        check(!decode(packed.size() - 2, back), "fse tokens", what + ": short payload accepted");
+        if (!matches) continue;
+
+        // The literal state is the first thing after the counts.
+        uint32_t u = 0;
+        while (lit_dec.table[u].symbol < 256) u++;
+        for (int k = 0; k < lit.table_log; k++) {
+            uint64_t bit = header + k;
+            uint8_t mask = (uint8_t)(0x80 >> (bit & 7));
+            if (u >> (lit.table_log - 1 - k) & 1) packed[bit / 8] |= mask;
+            else packed[bit / 8] &= (uint8_t)~mask;
+        }
+        check(!decode(packed.size(), back), "fse tokens", "match before the start accepted");
+    }
+}
+
+int main() {
+    mt19937 rng(12345);
+    test_histogram(rng);
+    test_match_length(rng);
+    test_copy_match(rng);
+    test_huffman4(rng);
+    test_fse(rng);
+    test_fse_tokens(rng);
+    if (failures) {
+        fprintf(stderr, "%d kernel test(s) failed\n", failures);
+        return 1;
+    }
+    printf("kernel tests passed\n");
+    return 0;
+}